@@ -0,0 +1,1185 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <ctime>
+#include <iomanip>
+#include <iostream>
+#include <mutex>
+#include <numeric>
+#include <optional>
+#include <queue>
+#include <random>
+#include <set>
+#include <shared_mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#if defined(__linux__)
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+#include "Iterator.cpp"
+#include "ConcurrentList.hpp"
+#include "CombiningList.hpp"
+#include "ShardedList.hpp"
+#include "LRUCache.hpp"
+#include "ShardedLRUCache.hpp"
+#include "TimerWheel.hpp"
+#include "HashIndex.hpp"
+#include "SplitOrderedMap.hpp"
+#include "SkipList.hpp"
+
+#include "catch.hpp"
+
+// Benchmarks are hidden from the default run, start them with
+//   DoubleList.exe "[benchmark]"
+
+namespace {
+
+    const int kThreadCounts[] = { 1, 2, 4, 8, 16, 32, 64 };
+
+    // Starts every worker at once and returns the wall time in seconds
+    template<typename Body>
+    double run_threads(int count, Body body) {
+        std::atomic<bool> go{ false };
+        std::vector<std::thread> workers;
+        for (int t = 0; t < count; t++) {
+            workers.emplace_back([&, t] {
+                while (!go.load(std::memory_order_acquire)) std::this_thread::yield();
+                body(t);
+            });
+        }
+
+        auto start = std::chrono::steady_clock::now();
+        go.store(true, std::memory_order_release);
+        for (auto& w : workers) w.join();
+        return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    }
+
+    // The baseline every concurrent variant has to beat
+    template<typename ValueType>
+    class LockedList
+    {
+    public:
+        void push_back(ValueType value) {
+            std::lock_guard<std::mutex> lock(mutex);
+            list.push_back(std::move(value));
+        }
+
+        std::optional<ValueType> pop_front() {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (list.empty()) return std::nullopt;
+            return list.pop_front();
+        }
+
+    private:
+        std::mutex mutex;
+        CLinkedList<ValueType> list;
+    };
+
+    // The pattern CLRUCache replaces: a hit erases the node and pushes a new one
+    class EraseAndPushLRU
+    {
+    public:
+        explicit EraseAndPushLRU(std::size_t capacity) : capacity(capacity) {}
+
+        long long* get(long long key) {
+            auto found = index.find(key);
+            if (found == index.end()) return nullptr;
+
+            auto entry = *found->second;
+            recency.erase(found->second);
+            recency.push_front(entry);
+            found->second = recency.begin();
+            return &found->second->second;
+        }
+
+        void put(long long key, long long value) {
+            auto found = index.find(key);
+            if (found != index.end()) {
+                recency.erase(found->second);
+                index.erase(found);
+            }
+            recency.push_front({ key, value });
+            index.emplace(key, recency.begin());
+            if (index.size() > capacity) {
+                auto last = --recency.end();
+                index.erase(last->first);
+                recency.erase(last);
+            }
+        }
+
+    private:
+        std::size_t capacity;
+        CLinkedList<std::pair<long long, long long>> recency;
+        std::unordered_map<long long, ListIterator<std::pair<long long, long long>>> index;
+    };
+
+    // producers push `total` values between them, consumers drain them
+    template<typename Queue>
+    double producer_consumer(Queue& queue, int producers, int consumers, long long total) {
+        std::atomic<long long> popped{ 0 };
+        const long long per_producer = total / producers;
+
+        return run_threads(producers + consumers, [&](int t) {
+            if (t < producers) {
+                for (long long i = 0; i < per_producer; i++)
+                    queue.push_back(i);
+            }
+            else {
+                while (popped.load(std::memory_order_relaxed) < per_producer * producers) {
+                    if (queue.pop_front()) popped.fetch_add(1, std::memory_order_relaxed);
+                    else std::this_thread::yield();
+                }
+            }
+        });
+    }
+
+    void print_row(const std::string& name, int threads, long long ops, double seconds) {
+        std::cout << std::left << std::setw(28) << name
+                  << std::right << std::setw(6) << threads
+                  << std::setw(12) << std::fixed << std::setprecision(2) << ops / seconds / 1e6 << " Mops/s\n";
+    }
+
+    // Hardware counters for the calling thread through perf_event_open.
+    // Linux only; elsewhere, or when perf_event_paranoid forbids it,
+    // available() is false and only the wall time gets reported.
+    class PerfCounters
+    {
+    public:
+        enum Counter { l1d_misses, llc_misses, dtlb_misses, branch_misses, kCounters };
+
+        PerfCounters() {
+#if defined(__linux__)
+            const std::pair<std::uint32_t, std::uint64_t> events[kCounters] = {
+                { PERF_TYPE_HW_CACHE, PERF_COUNT_HW_CACHE_L1D | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16) },
+                { PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES },
+                { PERF_TYPE_HW_CACHE, PERF_COUNT_HW_CACHE_DTLB | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16) },
+                { PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES },
+            };
+            for (int i = 0; i < kCounters; i++) {
+                perf_event_attr attr{};
+                attr.size = sizeof(attr);
+                attr.type = events[i].first;
+                attr.config = events[i].second;
+                attr.disabled = 1;
+                attr.exclude_kernel = 1;
+                attr.exclude_hv = 1;
+                fds[i] = static_cast<int>(syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0));
+            }
+#endif
+        }
+
+        ~PerfCounters() {
+#if defined(__linux__)
+            for (int fd : fds) {
+                if (fd >= 0) close(fd);
+            }
+#endif
+        }
+
+        PerfCounters(const PerfCounters& other) = delete;
+        PerfCounters& operator=(const PerfCounters& other) = delete;
+
+        bool available() const {
+            for (int fd : fds) {
+                if (fd >= 0) return true;
+            }
+            return false;
+        }
+
+        void start() {
+#if defined(__linux__)
+            for (int fd : fds) {
+                if (fd < 0) continue;
+                ioctl(fd, PERF_EVENT_IOC_RESET, 0);
+                ioctl(fd, PERF_EVENT_IOC_ENABLE, 0);
+            }
+#endif
+        }
+
+        // Counts since start(), -1 for counters the CPU or kernel doesn't offer
+        std::vector<long long> stop() {
+            std::vector<long long> counts(kCounters, -1);
+#if defined(__linux__)
+            for (int i = 0; i < kCounters; i++) {
+                if (fds[i] < 0) continue;
+                ioctl(fds[i], PERF_EVENT_IOC_DISABLE, 0);
+                long long value = 0;
+                if (read(fds[i], &value, sizeof(value)) == sizeof(value)) counts[i] = value;
+            }
+#endif
+            return counts;
+        }
+
+    private:
+        int fds[kCounters] = { -1, -1, -1, -1 };
+    };
+
+    // One line per scenario: time and every counter divided by the element count
+    void print_perf_row(const std::string& name, long long elements, double seconds, const std::vector<long long>& counts) {
+        std::cout << std::left << std::setw(28) << name << std::right
+                  << std::setw(10) << std::fixed << std::setprecision(2) << seconds * 1e9 / elements;
+        for (long long count : counts) {
+            if (count < 0) std::cout << std::setw(10) << "-";
+            else std::cout << std::setw(10) << std::setprecision(3) << static_cast<double>(count) / elements;
+        }
+        std::cout << '\n';
+    }
+}
+
+TEST_CASE("ConcurrentList throughput", "[.][benchmark]") {
+    const long long total = 1 << 20;
+
+    std::cout << "push_back/pop_front, threads = producers = consumers\n";
+    for (int threads : kThreadCounts) {
+        CConcurrentList<long long> queue;
+        print_row("CConcurrentList", threads, total, producer_consumer(queue, threads, threads, total));
+    }
+}
+
+TEST_CASE("ConcurrentList policies vs mutex", "[.][benchmark]") {
+    const long long total = 1 << 20;
+
+    std::cout << "single producer, single consumer\n";
+    {
+        CConcurrentList<long long, SPSC> spsc;
+        CConcurrentList<long long, MPSC> mpsc;
+        CConcurrentList<long long, MPMC> mpmc;
+        LockedList<long long> locked;
+        print_row("SPSC", 1, total, producer_consumer(spsc, 1, 1, total));
+        print_row("MPSC", 1, total, producer_consumer(mpsc, 1, 1, total));
+        print_row("MPMC", 1, total, producer_consumer(mpmc, 1, 1, total));
+        print_row("mutex + CLinkedList", 1, total, producer_consumer(locked, 1, 1, total));
+    }
+
+    std::cout << "many producers, single consumer, threads = producers\n";
+    for (int threads : kThreadCounts) {
+        CConcurrentList<long long, MPSC> mpsc;
+        CConcurrentList<long long, MPMC> mpmc;
+        LockedList<long long> locked;
+        print_row("MPSC", threads, total, producer_consumer(mpsc, threads, 1, total));
+        print_row("MPMC", threads, total, producer_consumer(mpmc, threads, 1, total));
+        print_row("mutex + CLinkedList", threads, total, producer_consumer(locked, threads, 1, total));
+    }
+}
+
+TEST_CASE("ConcurrentList wake-up latency", "[.][benchmark]") {
+    using namespace std::chrono;
+    const int samples = 2000;
+
+    // Consumers park in wait_pop, the producer stamps every value with its push time
+    CConcurrentList<steady_clock::time_point> queue;
+    std::vector<double> latency_us;
+    latency_us.reserve(samples);
+
+    std::thread consumer([&] {
+        for (int i = 0; i < samples; i++) {
+            auto pushed = queue.wait_pop();
+            latency_us.push_back(duration<double, std::micro>(steady_clock::now() - pushed).count());
+        }
+    });
+    for (int i = 0; i < samples; i++) {
+        std::this_thread::sleep_for(microseconds(200));
+        queue.push_back(steady_clock::now());
+    }
+    consumer.join();
+
+    std::sort(latency_us.begin(), latency_us.end());
+    std::cout << "wait_pop wake-up latency: p50 " << latency_us[samples / 2]
+              << " us, p99 " << latency_us[samples * 99 / 100]
+              << " us, max " << latency_us.back() << " us\n";
+
+    // Parked consumers should not show up in the process CPU time at all
+    std::vector<std::thread> idle;
+    for (int t = 0; t < 8; t++) idle.emplace_back([&] { queue.wait_pop(); });
+    std::this_thread::sleep_for(milliseconds(50));
+
+    auto cpu_start = std::clock();
+    std::this_thread::sleep_for(milliseconds(500));
+    auto cpu_ms = 1000.0 * (std::clock() - cpu_start) / CLOCKS_PER_SEC;
+    std::cout << "8 parked consumers over 500 ms used " << cpu_ms << " ms of CPU\n";
+
+    for (int t = 0; t < 8; t++) queue.push_back(steady_clock::now());
+    for (auto& t : idle) t.join();
+}
+
+TEST_CASE("CombiningList contended writers", "[.][benchmark]") {
+    const long long total = 1 << 19;
+
+    // Every thread appends and erases from the front, all on the same two cache lines
+    std::cout << "push_back + pop_front pairs, threads = writers\n";
+    for (int threads : kThreadCounts) {
+        const long long per_thread = total / threads;
+
+        CCombiningList<long long> combining;
+        print_row("CCombiningList", threads, 2 * per_thread * threads, run_threads(threads, [&](int) {
+            for (long long i = 0; i < per_thread; i++) {
+                combining.push_back(i);
+                combining.pop_front();
+            }
+        }));
+
+        LockedList<long long> locked;
+        print_row("mutex + CLinkedList", threads, 2 * per_thread * threads, run_threads(threads, [&](int) {
+            for (long long i = 0; i < per_thread; i++) {
+                locked.push_back(i);
+                locked.pop_front();
+            }
+        }));
+    }
+}
+
+TEST_CASE("ShardedList append scaling", "[.][benchmark]") {
+    const long long per_thread = 1 << 17;
+
+    std::cout << "appends, " << per_thread << " per thread\n";
+    for (int threads : kThreadCounts) {
+        CShardedList<long long> sharded;
+        print_row("CShardedList", threads, per_thread * threads, run_threads(threads, [&](int) {
+            for (long long i = 0; i < per_thread; i++) sharded.push_back(i);
+        }));
+
+        CCombiningList<long long> combining;
+        print_row("CCombiningList", threads, per_thread * threads, run_threads(threads, [&](int) {
+            for (long long i = 0; i < per_thread; i++) combining.push_back(i);
+        }));
+
+        LockedList<long long> locked;
+        print_row("mutex + CLinkedList", threads, per_thread * threads, run_threads(threads, [&](int) {
+            for (long long i = 0; i < per_thread; i++) locked.push_back(i);
+        }));
+    }
+
+    CShardedList<long long> sharded;
+    run_threads(8, [&](int) {
+        for (long long i = 0; i < per_thread; i++) sharded.push_back(i);
+    });
+    long long sum = 0;
+    auto start = std::chrono::steady_clock::now();
+    sharded.for_each_unordered([&](std::uint64_t, long long v) { sum += v; });
+    print_row("scan unordered", 1, 8 * per_thread, std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count());
+    start = std::chrono::steady_clock::now();
+    sharded.for_each_ordered([&](std::uint64_t, long long v) { sum -= v; });
+    print_row("scan merged by sequence", 1, 8 * per_thread, std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count());
+    REQUIRE(sum == 0);
+}
+
+TEST_CASE("ListIterator biased ref counting", "[.][benchmark]") {
+    const long long steps = 1 << 22;
+
+    // Built here, so this thread owns every node
+    CLinkedList<long long> list;
+    for (long long i = 0; i < 1024; i++) list.push_back(i);
+
+    // Every step copies and drops an iterator, i.e. two ref count updates
+    auto walk = [&] {
+        long long sum = 0;
+        for (long long done = 0; done < steps;) {
+            for (auto it = list.begin(); it != list.end() && done < steps; ++it, done++) sum += *it;
+        }
+        return sum;
+    };
+
+    // The floor the owner is measured against: the same hops, end() and
+    // erased checks included, over plain int counts with no bias at all
+    struct PlainNode {
+        long long val;
+        PlainNode* next;
+        bool deleted;
+        int ref_count;
+    };
+    std::vector<PlainNode> plain(1025);
+    for (std::size_t i = 0; i < plain.size(); i++) plain[i] = PlainNode{ static_cast<long long>(i), i + 1 < plain.size() ? &plain[i + 1] : nullptr, false, 2 };
+    PlainNode* plain_end = &plain.back();
+    auto plain_walk = [&] {
+        long long sum = 0;
+        for (long long done = 0; done < steps;) {
+            PlainNode* node = &plain.front();
+            node->ref_count++;
+            while (done < steps) {
+                plain_end->ref_count++;
+                bool at_end = node == plain_end;
+                plain_end->ref_count--;
+                if (at_end) break;
+
+                sum += node->val;
+                auto next = node->next;
+                while (next->deleted && next->next) next = next->next;
+                next->ref_count++;
+                node->ref_count--;
+                node = next;
+                done++;
+            }
+            node->ref_count--;
+        }
+        return sum;
+    };
+
+    std::cout << "iterator steps over a list owned by the main thread\n";
+    long long plain_sum = 0, owner_sum = 0, foreign_sum = 0;
+
+    auto start = std::chrono::steady_clock::now();
+    plain_sum = plain_walk();
+    print_row("plain int counts", 1, steps, std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count());
+
+    start = std::chrono::steady_clock::now();
+    owner_sum = walk();
+    print_row("owner thread (biased)", 1, steps, std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count());
+
+    print_row("other thread (atomic)", 1, steps, run_threads(1, [&](int) { foreign_sum = walk(); }));
+    REQUIRE(owner_sum == foreign_sum);
+    REQUIRE(plain_sum == owner_sum);
+}
+
+TEST_CASE("ListIterator deferred ref counting", "[.][benchmark]") {
+    const long long steps = 1 << 20;
+
+    CLinkedList<long long> list;
+    for (long long i = 0; i < 1024; i++) list.push_back(i);
+
+    // Read-only scans from threads that don't own the nodes
+    auto walk = [&] {
+        long long sum = 0;
+        for (long long done = 0; done < steps;) {
+            for (auto it = list.begin(); it != list.end() && done < steps; ++it, done++) sum += *it;
+        }
+        return sum;
+    };
+
+    std::cout << "concurrent read-only scans, " << steps << " steps per thread\n";
+    for (int threads : kThreadCounts) {
+        std::vector<long long> plain(threads), deferred(threads);
+
+        print_row("immediate ref counts", threads, steps * threads, run_threads(threads, [&](int t) {
+            plain[t] = walk();
+        }));
+        print_row("deferred ref counts", threads, steps * threads, run_threads(threads, [&](int t) {
+            DeferredRefCounts<long long> scope;
+            deferred[t] = walk();
+        }));
+        REQUIRE(plain == deferred);
+    }
+}
+
+TEST_CASE("CLinkedList borrowed range", "[.][benchmark]") {
+    const int passes = 4096;
+
+    CLinkedList<long long> list;
+    for (long long i = 0; i < 1024; i++) list.push_back(i);
+
+    auto time = [](auto body) {
+        auto start = std::chrono::steady_clock::now();
+        body();
+        return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    };
+
+    long long counted = 0, borrowed = 0;
+    std::cout << "range-for over 1024 elements, " << passes << " passes\n";
+    print_row("ListIterator", 1, passes * 1024LL, time([&] {
+        for (int pass = 0; pass < passes; pass++) {
+            for (auto value : list) counted += value;
+        }
+    }));
+    print_row("for_each_borrowed", 1, passes * 1024LL, time([&] {
+        for (int pass = 0; pass < passes; pass++) {
+            for (auto value : list.for_each_borrowed()) borrowed += value;
+        }
+    }));
+    REQUIRE(counted == borrowed);
+}
+
+TEST_CASE("CLinkedList weak handles", "[.][benchmark]") {
+    const long long count = 1 << 16;
+
+    CLinkedList<long long> list;
+    for (long long i = 0; i < count; i++) list.push_back(i);
+
+    std::vector<WeakHandle> handles;
+    std::vector<ListIterator<long long>> iterators;
+    for (auto it = list.begin(); it != list.end(); ++it) {
+        handles.push_back(list.handle(it));
+        iterators.push_back(it);
+    }
+
+    // Erase every other element, parked iterators keep those nodes alive
+    for (auto it = list.begin(); it != list.end(); ++it) it = list.erase(it);
+
+    auto time = [](auto body) {
+        auto start = std::chrono::steady_clock::now();
+        body();
+        return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    };
+
+    long long by_handle = 0, by_iterator = 0;
+    std::cout << count << " cached positions, half of them erased\n";
+    print_row("WeakHandle resolve", 1, count, time([&] {
+        for (auto& h : handles) {
+            if (list.contains(h)) by_handle += *list.resolve(h);
+        }
+    }));
+    print_row("ListIterator is_erased", 1, count, time([&] {
+        for (auto& it : iterators) {
+            if (!it.is_erased()) by_iterator += *it;
+        }
+    }));
+    std::cout << "pinned zombie nodes: handles 0, iterators " << count / 2 << "\n";
+    REQUIRE(by_handle == by_iterator);
+}
+
+TEST_CASE("ListIterator erased chains", "[.][benchmark]") {
+    const int parked = 1024;
+
+    std::cout << parked << " iterators parked on the head of an erased chain, one step each\n";
+    for (int chain : { 16, 256, 4096 }) {
+        CLinkedList<long long> list;
+        for (long long i = 0; i < chain + 2; i++) list.push_back(i);
+
+        std::vector<ListIterator<long long>> iterators(parked, ++list.begin());
+        auto it = ++list.begin();
+        for (int i = 0; i < chain; i++) it = list.erase(it);
+
+        auto start = std::chrono::steady_clock::now();
+        long long sum = 0;
+        for (auto& parked_it : iterators) sum += *++parked_it;
+        print_row("chain of " + std::to_string(chain), 1, parked, std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count());
+        REQUIRE(sum == (chain + 1LL) * parked);
+    }
+}
+
+TEST_CASE("CLinkedList metrics overhead", "[.][benchmark]") {
+    const long long ops = 1 << 20;
+
+    auto churn = [&](ListMetrics* metrics) {
+        CLinkedList<long long> list;
+        list.attach_metrics(metrics);
+
+        auto start = std::chrono::steady_clock::now();
+        for (long long i = 0; i < ops; i++) {
+            list.push_back(i);
+            list.pop_front();
+        }
+        return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    };
+
+    // Steps are only counted, calls also read the clock twice
+    auto walk = [&](ListMetrics* metrics) {
+        CLinkedList<long long> list;
+        for (long long i = 0; i < 1024; i++) list.push_back(i);
+        list.attach_metrics(metrics);
+
+        auto start = std::chrono::steady_clock::now();
+        for (long long done = 0; done < ops;) {
+            for (auto it = list.begin(); it != list.end() && done < ops; ++it) done++;
+        }
+        return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    };
+
+    ListMetrics metrics("bench");
+    std::cout << "push_back + pop_front pairs\n";
+    print_row("detached", 1, ops, churn(nullptr));
+    print_row("attached", 1, ops, churn(&metrics));
+    std::cout << "iterator steps\n";
+    print_row("detached", 1, ops, walk(nullptr));
+    print_row("attached", 1, ops, walk(&metrics));
+    REQUIRE(metrics.total(ListMetrics::push) == ops);
+    REQUIRE(metrics.total(ListMetrics::step) == ops);
+}
+
+TEST_CASE("CLinkedList traversal counters", "[.][benchmark][perf]") {
+    const long long elements = 1 << 18;
+    const int passes = 8;
+
+    PerfCounters counters;
+    if (!counters.available()) std::cout << "perf_event_open not available, wall time only\n";
+
+    // Same values, two node layouts: allocation order matches link order,
+    // or every node went in before a random earlier one
+    CLinkedList<long long> sequential;
+    for (long long i = 0; i < elements; i++) sequential.push_back(i);
+
+    CLinkedList<long long> shuffled;
+    {
+        std::mt19937_64 rng(42);
+        std::vector<ListIterator<long long>> placed;
+        placed.reserve(elements);
+        placed.push_back(shuffled.inserts(shuffled.end(), 0));
+        for (long long i = 1; i < elements; i++) {
+            auto& before = placed[rng() % placed.size()];
+            placed.push_back(shuffled.inserts(before, i));
+        }
+    }
+
+    auto measure = [&](const std::string& name, auto walk) {
+        long long sum = 0;
+        walk(sum);
+
+        counters.start();
+        auto start = std::chrono::steady_clock::now();
+        for (int pass = 0; pass < passes; pass++) walk(sum);
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        print_perf_row(name, elements * passes, seconds, counters.stop());
+        return sum;
+    };
+
+    std::cout << elements << " elements, per element:\n";
+    std::cout << std::left << std::setw(28) << "" << std::right << std::setw(10) << "ns" << std::setw(10) << "L1D"
+              << std::setw(10) << "LLC" << std::setw(10) << "dTLB" << std::setw(10) << "branch" << '\n';
+
+    long long expected = 0;
+    for (auto* list : { &sequential, &shuffled }) {
+        std::string layout = list == &sequential ? "sequential" : "shuffled";
+        auto counted = measure(layout + " ListIterator", [&](long long& sum) {
+            for (auto it = list->begin(); it != list->end(); ++it) sum += *it;
+        });
+        auto borrowed = measure(layout + " borrowed", [&](long long& sum) {
+            for (auto value : list->for_each_borrowed()) sum += value;
+        });
+        REQUIRE(counted == borrowed);
+        if (!expected) expected = counted;
+        REQUIRE(counted == expected);
+    }
+}
+
+TEST_CASE("CLinkedList erase tail latency", "[.][benchmark]") {
+    using namespace std::chrono;
+    const long long elements = 1 << 16;
+    const int rounds = 1 << 16;
+
+    // ns at p50, p99, p99.9 and the worst sample
+    auto report = [](const std::string& name, long long parked, std::vector<long long>& ns) {
+        std::sort(ns.begin(), ns.end());
+        std::cout << std::left << std::setw(10) << name << std::right << std::setw(10) << parked
+                  << std::setw(10) << ns[ns.size() / 2] << std::setw(10) << ns[ns.size() * 99 / 100]
+                  << std::setw(10) << ns[ns.size() * 999 / 1000] << std::setw(12) << ns.back() << '\n';
+    };
+
+    std::cout << "random erase + insert + re-seating one parked iterator per round, ns\n";
+    std::cout << std::left << std::setw(10) << "" << std::right << std::setw(10) << "parked" << std::setw(10) << "p50"
+              << std::setw(10) << "p99" << std::setw(10) << "p99.9" << std::setw(12) << "max" << '\n';
+
+    for (long long parked : { 0LL, 1LL << 10, 1LL << 16, 1LL << 20 }) {
+        std::mt19937_64 rng(7);
+        CLinkedList<long long> list;
+        std::vector<WeakHandle> live;
+        for (long long i = 0; i < elements; i++) {
+            list.push_back(i);
+            live.push_back(list.handle(--list.end()));
+        }
+
+        auto random_live = [&] { return list.resolve(live[rng() % live.size()]); };
+
+        std::vector<ListIterator<long long>> iterators;
+        iterators.reserve(parked);
+        for (long long i = 0; i < parked; i++) iterators.push_back(random_live());
+
+        std::vector<long long> erase_ns, insert_ns, reseat_ns;
+        erase_ns.reserve(rounds);
+        insert_ns.reserve(rounds);
+        reseat_ns.reserve(rounds);
+
+        for (int round = 0; round < rounds; round++) {
+            // Erased nodes turn into zombies wherever an iterator is parked on them
+            auto victim = rng() % live.size();
+            auto it = list.resolve(live[victim]);
+            live[victim] = live.back();
+            live.pop_back();
+
+            auto start = steady_clock::now();
+            list.erase(it);
+            erase_ns.push_back(duration_cast<nanoseconds>(steady_clock::now() - start).count());
+
+            auto before = random_live();
+            start = steady_clock::now();
+            auto inserted = list.inserts(before, round);
+            insert_ns.push_back(duration_cast<nanoseconds>(steady_clock::now() - start).count());
+            live.push_back(list.handle(inserted));
+
+            // Dropping a pin is where zombie chains get freed
+            if (parked) {
+                auto& moved = iterators[rng() % iterators.size()];
+                auto target = random_live();
+                start = steady_clock::now();
+                moved = target;
+                reseat_ns.push_back(duration_cast<nanoseconds>(steady_clock::now() - start).count());
+            }
+        }
+
+        report("erase", parked, erase_ns);
+        report("insert", parked, insert_ns);
+        if (parked) report("re-seat", parked, reseat_ns);
+        REQUIRE(list.size() == static_cast<std::size_t>(elements));
+    }
+}
+
+TEST_CASE("LRUCache hits and misses", "[.][benchmark]") {
+    const long long capacity = 1 << 14;
+    const long long ops = 1 << 21;
+
+    // get, and put on a miss; key_range / capacity sets the miss rate
+    auto run = [&](auto& cache, long long key_range) {
+        std::mt19937_64 rng(3);
+        long long hits = 0;
+        auto start = std::chrono::steady_clock::now();
+        for (long long i = 0; i < ops; i++) {
+            long long key = static_cast<long long>(rng() % key_range);
+            if (cache.get(key)) hits++;
+            else cache.put(key, key);
+        }
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        return std::make_pair(seconds, hits);
+    };
+
+    std::cout << "get + put on miss, " << capacity << " entries\n";
+    for (long long key_range : { capacity, 2 * capacity, 8 * capacity }) {
+        CLRUCache<long long, long long> cache(capacity);
+        EraseAndPushLRU baseline(capacity);
+
+        auto relinked = run(cache, key_range);
+        auto reallocated = run(baseline, key_range);
+        std::string hit_rate = std::to_string(100 * relinked.second / ops) + "% hits";
+        print_row("CLRUCache " + hit_rate, 1, ops, relinked.first);
+        print_row("erase+push " + hit_rate, 1, ops, reallocated.first);
+        REQUIRE(relinked.second == reallocated.second);
+    }
+}
+
+TEST_CASE("ShardedLRUCache read scaling", "[.][benchmark]") {
+    const long long capacity = 1 << 16;
+    const long long ops_per_thread = 1 << 18;
+
+    // 90% get, misses and the other 10% put; keys fit so almost every get hits
+    auto mix = [&](auto get, auto put) {
+        return [=](int t) {
+            std::mt19937_64 rng(t);
+            for (long long i = 0; i < ops_per_thread; i++) {
+                long long key = static_cast<long long>(rng() % capacity);
+                if (rng() % 10 == 0 || !get(key)) put(key);
+            }
+        };
+    };
+
+    std::cout << "90% get / 10% put over " << capacity << " hot keys\n";
+    for (int threads : kThreadCounts) {
+        {
+            std::mutex lock;
+            CLRUCache<long long, long long> cache(capacity);
+            auto body = mix(
+                [&](long long key) { std::lock_guard<std::mutex> guard(lock); return cache.get(key) != nullptr; },
+                [&](long long key) { std::lock_guard<std::mutex> guard(lock); cache.put(key, key); });
+            print_row("CLRUCache + mutex", threads, ops_per_thread * threads, run_threads(threads, body));
+        }
+
+        const std::pair<Promotion, const char*> policies[] = {
+            { Promotion::always, "sharded, always" },
+            { Promotion::sampled, "sharded, sampled" },
+            { Promotion::buffered, "sharded, buffered" },
+        };
+        for (auto& policy : policies) {
+            CShardedLRUCache<long long, long long> cache(capacity, policy.first, 16);
+            auto body = mix(
+                [&](long long key) { return cache.get(key).has_value(); },
+                [&](long long key) { cache.put(key, key); });
+            print_row(policy.second, threads, ops_per_thread * threads, run_threads(threads, body));
+        }
+    }
+}
+
+TEST_CASE("TimerWheel vs heap timeouts", "[.][benchmark]") {
+    const long long connections = 1 << 16;
+    const long long ticks = 1 << 17;
+    const long long timeout = 30000;
+
+    // Idle timeouts: every tick some connections see traffic and push their
+    // timeout back, a connection without traffic for timeout ms expires and
+    // gets a fresh timer on its next traffic.
+    auto run = [&](auto touch, auto advance, long long active) {
+        std::mt19937_64 rng(5);
+        long long fired = 0;
+        auto start = std::chrono::steady_clock::now();
+        for (long long tick = 0; tick < ticks; tick++) {
+            for (long long i = 0; i < active; i++) touch(static_cast<long long>(rng() % connections));
+            fired += advance();
+        }
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        return std::make_pair(seconds, fired);
+    };
+
+    std::cout << connections << " connections, " << timeout << " ms idle timeout\n";
+    for (long long active : { 16, 64, 256 }) {
+        CTimerWheel<long long> wheel;
+        std::vector<CTimerWheel<long long>::handle> handles(connections);
+        auto wheeled = run(
+            [&](long long id) {
+                if (!wheel.reschedule(handles[id], std::chrono::milliseconds(timeout)))
+                    handles[id] = wheel.schedule(std::chrono::milliseconds(timeout), id);
+            },
+            [&] { return static_cast<long long>(wheel.advance(std::chrono::milliseconds(1), [](long long) {})); },
+            active);
+
+        // The usual heap: rescheduling pushes a new entry, stale ones are skipped when they surface
+        using Entry = std::pair<long long, long long>;
+        std::priority_queue<Entry, std::vector<Entry>, std::greater<Entry>> heap;
+        std::vector<long long> deadlines(connections, -1);
+        long long now = 0;
+        auto heaped = run(
+            [&](long long id) {
+                deadlines[id] = now + timeout;
+                heap.emplace(deadlines[id], id);
+            },
+            [&] {
+                long long expired = 0;
+                now++;
+                while (!heap.empty() && heap.top().first <= now) {
+                    auto [deadline, id] = heap.top();
+                    heap.pop();
+                    if (deadlines[id] != deadline) continue;
+                    deadlines[id] = -1;
+                    expired++;
+                }
+                return expired;
+            },
+            active);
+
+        std::string label = std::to_string(active) + " touches/ms";
+        print_row("CTimerWheel " + label, 1, ticks * active, wheeled.first);
+        print_row("lazy heap " + label, 1, ticks * active, heaped.first);
+        REQUIRE(wheeled.second == heaped.second);
+    }
+}
+
+TEST_CASE("HashIndex find vs linear search", "[.][benchmark]") {
+    std::cout << "find a random present key\n";
+    for (long long length : { 16, 256, 4096 }) {
+        CLinkedList<long long> list;
+        for (long long i = 0; i < length; i++) list.push_back(i * 3);
+        const long long lookups = (1 << 24) / length;
+
+        auto run = [&](auto find) {
+            std::mt19937_64 rng(11);
+            long long found = 0;
+            auto start = std::chrono::steady_clock::now();
+            for (long long i = 0; i < lookups; i++) {
+                if (find(static_cast<long long>(rng() % length) * 3)) found++;
+            }
+            double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+            REQUIRE(found == lookups);
+            return seconds;
+        };
+
+        std::string label = std::to_string(length) + " elements";
+        print_row("std::find " + label, 1, lookups,
+            run([&](long long key) { return std::find(list.begin(), list.end(), key) != list.end(); }));
+        print_row("borrowed scan " + label, 1, lookups, run([&](long long key) {
+            auto range = list.for_each_borrowed();
+            return std::find(range.begin(), range.end(), key) != range.end();
+        }));
+
+        CHashIndex<long long> index(list);
+        print_row("CHashIndex " + label, 1, lookups, run([&](long long key) { return index.find(key) != list.end(); }));
+    }
+}
+
+TEST_CASE("SplitOrderedMap vs striped unordered_map", "[.][benchmark]") {
+    const long long keys = 1 << 16;
+    const long long ops_per_thread = 1 << 18;
+    const int kStripes = 16;
+
+    // Mutex per stripe, keys spread over the stripes by hash
+    struct StripedMap {
+        struct alignas(64) Stripe {
+            std::mutex lock;
+            std::unordered_map<long long, long long> map;
+        };
+        Stripe stripes[kStripes];
+
+        Stripe& stripe(long long key) {
+            return stripes[(static_cast<std::uint64_t>(key) * 0x9E3779B97F4A7C15ull >> 32) % kStripes];
+        }
+        bool insert(long long key, long long value) {
+            Stripe& s = stripe(key);
+            std::lock_guard<std::mutex> guard(s.lock);
+            return s.map.emplace(key, value).second;
+        }
+        bool erase(long long key) {
+            Stripe& s = stripe(key);
+            std::lock_guard<std::mutex> guard(s.lock);
+            return s.map.erase(key) != 0;
+        }
+        bool contains(long long key) {
+            Stripe& s = stripe(key);
+            std::lock_guard<std::mutex> guard(s.lock);
+            return s.map.count(key) != 0;
+        }
+    };
+
+    // 90% lookups, 5% inserts, 5% erases over a half full key range
+    auto mix = [&](auto& map) {
+        for (long long key = 0; key < keys; key += 2) map.insert(key, key);
+        return [&](int t) {
+            std::mt19937_64 rng(t);
+            for (long long i = 0; i < ops_per_thread; i++) {
+                long long key = static_cast<long long>(rng() % keys);
+                auto op = rng() % 20;
+                if (op == 0) map.insert(key, key);
+                else if (op == 1) map.erase(key);
+                else map.contains(key);
+            }
+        };
+    };
+
+    std::cout << "90% contains / 5% insert / 5% erase over " << keys << " keys\n";
+    for (int threads : kThreadCounts) {
+        {
+            auto striped = std::make_unique<StripedMap>();
+            print_row("unordered_map, 16 stripes", threads, ops_per_thread * threads, run_threads(threads, mix(*striped)));
+        }
+        {
+            CSplitOrderedMap<long long, long long> split;
+            print_row("CSplitOrderedMap", threads, ops_per_thread * threads, run_threads(threads, mix(split)));
+        }
+    }
+}
+
+TEST_CASE("SkipList read scaling", "[.][benchmark]") {
+    const long long keys = 1 << 16;
+    const long long ops_per_thread = 1 << 17;
+
+    // Thread 0 inserts and erases odd keys, everyone else looks keys up.
+    // The hits are summed up so the lookups can't be optimized away.
+    std::atomic<long long> hits{ 0 };
+    auto mix = [&](auto insert, auto erase, auto lookup) {
+        return [=, &hits](int t) {
+            std::mt19937_64 rng(t);
+            long long found = 0;
+            for (long long i = 0; i < ops_per_thread; i++) {
+                long long key = static_cast<long long>(rng() % keys);
+                if (t == 0) {
+                    if (i % 2 == 0) insert(key | 1);
+                    else erase(key | 1);
+                }
+                else {
+                    found += lookup(key);
+                }
+            }
+            hits += found;
+        };
+    };
+
+    std::cout << "one writer, readers doing lower_bound over " << keys << " keys\n";
+    for (int threads : kThreadCounts) {
+        {
+            std::shared_mutex lock;
+            std::multiset<long long> set;
+            for (long long key = 0; key < keys; key += 2) set.insert(key);
+            auto body = mix(
+                [&](long long key) { std::unique_lock<std::shared_mutex> guard(lock); set.insert(key); },
+                [&](long long key) {
+                    std::unique_lock<std::shared_mutex> guard(lock);
+                    auto found = set.find(key);
+                    if (found != set.end()) set.erase(found);
+                },
+                [&](long long key) { std::shared_lock<std::shared_mutex> guard(lock); return set.lower_bound(key) != set.end(); });
+            print_row("multiset + shared_mutex", threads, ops_per_thread * threads, run_threads(threads, body));
+        }
+        {
+            CSkipList<long long> list;
+            for (long long key = 0; key < keys; key += 2) list.insert(key);
+            auto body = mix(
+                [&](long long key) { list.insert(key); },
+                [&](long long key) { list.erase(key); },
+                [&](long long key) { return list.lower_bound(key) != list.end(); });
+            print_row("CSkipList", threads, ops_per_thread * threads, run_threads(threads, body));
+        }
+    }
+}
+
+TEST_CASE("CLinkedList chunked iteration", "[.][benchmark]") {
+    const long long length = 1 << 20;
+    const int passes = 16;
+    CLinkedList<int> list;
+    for (long long i = 0; i < length; i++) list.push_back(static_cast<int>(i % 1000));
+
+    // Sum of squares, the kind of kernel a compiler vectorizes over a span
+    auto run = [&](auto pass) {
+        long long total = 0;
+        auto start = std::chrono::steady_clock::now();
+        for (int p = 0; p < passes; p++) total += pass();
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        return std::make_pair(seconds, total);
+    };
+
+    auto iterated = run([&] {
+        long long sum = 0;
+        for (auto it = list.begin(); it != list.end(); ++it) sum += static_cast<long long>(*it) * *it;
+        return sum;
+    });
+    auto borrowed = run([&] {
+        long long sum = 0;
+        for (auto& value : list.for_each_borrowed()) sum += static_cast<long long>(value) * value;
+        return sum;
+    });
+    std::cout << "sum of squares over " << length << " ints\n";
+    print_row("ListIterator", 1, length * passes, iterated.first);
+    print_row("for_each_borrowed", 1, length * passes, borrowed.first);
+
+    for (std::size_t chunk : { 64, 256, 4096 }) {
+        auto chunked = run([&] {
+            long long sum = 0;
+            list.for_each_chunk([&](std::span<const int> values) {
+                for (int value : values) sum += static_cast<long long>(value) * value;
+            }, chunk);
+            return sum;
+        });
+        print_row("for_each_chunk " + std::to_string(chunk), 1, length * passes, chunked.first);
+        REQUIRE(chunked.second == iterated.second);
+    }
+    REQUIRE(borrowed.second == iterated.second);
+}
+
+TEST_CASE("CLinkedList prefetched scans", "[.][benchmark]") {
+    // Far past any last level cache, and linked in random order so every
+    // hop lands somewhere the hardware prefetcher can't guess
+    const long long length = 1 << 22;
+    CLinkedList<long long> list;
+    for (long long i = 0; i < length; i++) list.push_back(i);
+    {
+        std::vector<CLinkedList<long long>::iterator> nodes;
+        nodes.reserve(length);
+        for (auto it = list.begin(); it != list.end(); ++it) nodes.push_back(it);
+        std::shuffle(nodes.begin(), nodes.end(), std::mt19937_64(7));
+        for (auto& node : nodes) list.splice(list.end(), node);
+    }
+
+    auto run = [&](const std::string& name, auto scan) {
+        long long sum = 0;
+        auto start = std::chrono::steady_clock::now();
+        scan([&](long long value) { sum += value; });
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        print_row(name, 1, length, seconds);
+        REQUIRE(sum == length * (length - 1) / 2);
+    };
+
+    std::cout << "sum over " << length << " shuffled nodes\n";
+    run("for_each_borrowed", [&](auto add) { for (auto& value : list.for_each_borrowed()) add(value); });
+    for (std::size_t distance : { 4, 8, 16 }) {
+        run("for_each_prefetched " + std::to_string(distance), [&](auto add) { list.for_each_prefetched(add, distance); });
+    }
+    for (std::size_t cursors : { 2, 4, 8, 16 }) {
+        // Untimed first pass records the waypoints
+        list.for_each_interleaved([](long long) {}, cursors);
+        run("for_each_interleaved " + std::to_string(cursors), [&](auto add) { list.for_each_interleaved(add, cursors); });
+    }
+}
+
+TEST_CASE("Batched lookups", "[.][benchmark]") {
+    const std::size_t batch = 256;
+
+    {
+        const long long keys = 1 << 21;
+        const long long batches = 1 << 10;
+        CSkipList<long long> list;
+        {
+            // Inserted in random order, so neighbours don't share cache lines
+            std::vector<long long> values(keys);
+            std::iota(values.begin(), values.end(), 0);
+            std::shuffle(values.begin(), values.end(), std::mt19937_64(1));
+            for (auto value : values) list.insert(value * 2);
+        }
+
+        auto run = [&](auto lookup) {
+            std::mt19937_64 rng(2);
+            std::vector<long long> wanted(batch);
+            long long found = 0;
+            auto start = std::chrono::steady_clock::now();
+            for (long long b = 0; b < batches; b++) {
+                for (auto& key : wanted) key = static_cast<long long>(rng() % (2 * keys));
+                found += lookup(wanted);
+            }
+            double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+            return std::make_pair(seconds, found);
+        };
+
+        auto one_by_one = run([&](const std::vector<long long>& wanted) {
+            long long found = 0;
+            for (auto key : wanted) found += list.find(key) != list.end();
+            return found;
+        });
+        auto interleaved = run([&](const std::vector<long long>& wanted) {
+            long long found = 0;
+            for (auto& it : list.find_many(wanted)) found += it != list.end();
+            return found;
+        });
+        std::cout << "batches of " << batch << " lookups in a " << keys << " element skip list\n";
+        print_row("CSkipList find", 1, batches * batch, one_by_one.first);
+        print_row("CSkipList find_many", 1, batches * batch, interleaved.first);
+        REQUIRE(one_by_one.second == interleaved.second);
+    }
+
+    {
+        const long long length = 1 << 16;
+        const long long batches = 1 << 4;
+        CLinkedList<long long> list;
+        for (long long i = 0; i < length; i++) list.push_back(i);
+
+        std::mt19937_64 rng(3);
+        std::vector<long long> wanted(batch);
+        for (auto& key : wanted) key = static_cast<long long>(rng() % (2 * length));
+
+        long long found = 0;
+        auto start = std::chrono::steady_clock::now();
+        for (long long b = 0; b < batches; b++) {
+            auto range = list.for_each_borrowed();
+            for (auto key : wanted) found += std::find(range.begin(), range.end(), key) != range.end();
+        }
+        double scanned = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+        long long found_many = 0;
+        start = std::chrono::steady_clock::now();
+        for (long long b = 0; b < batches; b++) {
+            for (auto& it : list.find_many(wanted)) found_many += it != list.end();
+        }
+        double walked = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+        std::cout << "batches of " << batch << " lookups in a " << length << " element list\n";
+        print_row("borrowed std::find per key", 1, batches * batch, scanned);
+        print_row("CLinkedList find_many", 1, batches * batch, walked);
+        REQUIRE(found == found_many);
+    }
+}
+
+TEST_CASE("CLinkedList relinearize", "[.][benchmark]") {
+    // Linked in random order, like a list after a long stretch of churn
+    const long long length = 1 << 22;
+    CLinkedList<long long> list;
+    for (long long i = 0; i < length; i++) list.push_back(i);
+    {
+        std::vector<CLinkedList<long long>::iterator> nodes;
+        nodes.reserve(length);
+        for (auto it = list.begin(); it != list.end(); ++it) nodes.push_back(it);
+        std::shuffle(nodes.begin(), nodes.end(), std::mt19937_64(9));
+        for (auto& node : nodes) list.splice(list.end(), node);
+    }
+
+    auto scan = [&](const std::string& name) {
+        long long sum = 0;
+        auto start = std::chrono::steady_clock::now();
+        for (auto& value : list.for_each_borrowed()) sum += value;
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        print_row(name, 1, length, seconds);
+        REQUIRE(sum == length * (length - 1) / 2);
+    };
+
+    std::cout << "borrowed scan over " << length << " nodes\n";
+    scan("scattered");
+
+    auto start = std::chrono::steady_clock::now();
+    REQUIRE(list.relinearize() == static_cast<std::size_t>(length));
+    print_row("relinearize", 1, length, std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count());
+
+    scan("relinearized");
+}
@@ -9,15 +9,71 @@
 #include <cmath>
 #include <memory>
 #include <stdexcept>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <mutex>
+#include <span>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#if defined(_MSC_VER)
+#include <xmmintrin.h>
+#endif
+
+#include "ListMetrics.hpp"
+#include "NodePool.hpp"
+#include "NodeSlab.hpp"
+#include "ThreadSlot.hpp"
 
 // Эта сука ебаная точно работает сейчас
 // Предположим есть ссылка на лист в итераторе ебаном
 
+// Ref counts are biased towards the thread that created the node.
+// The owner bumps the plain ref_count, every other thread goes through the
+// atomic shared_count, which holds the count times kOne plus two flags.
+// When the owner's count drops to zero it sets kMerged and from then on
+// the node lives on shared_count alone. If another thread drives the shared
+// count below zero first (it dropped a reference the owner took), it marks
+// the node kQueued and hands it to the owner, who merges its part on its
+// next insert, erase() or merge_pending() call, or on exit. Checking on
+// inserts too means a thread that only produces still frees the nodes its
+// consumers pop.
+
+// Define CLINKEDLIST_ENABLE_STATS project-wide (it changes the node layout)
+// to have every list track what CLinkedList::stats() reports. Without it
+// only live is filled in and nothing is tracked.
+struct ListStats
+{
+    std::size_t live = 0;
+    // Erased nodes still kept alive by iterators or other zombies
+    std::size_t zombies = 0;
+    std::size_t zombie_bytes = 0;
+    std::size_t longest_zombie_chain = 0;
+    std::chrono::nanoseconds oldest_zombie_age{ 0 };
+    // Element nodes only, the sentinels don't count
+    std::uint64_t allocations = 0;
+    std::uint64_t frees = 0;
+    // Ref count updates actually applied, deferred ones that cancelled out aren't
+    std::uint64_t ref_count_ops = 0;
+};
+
 template<typename ValueType>
 class ListIterator;
 
 template<typename ValueType>
 class CLinkedList;
+
+template<typename ValueType>
+class DeferredRefCounts;
+
+template<typename ValueType>
+class BorrowedRange;
+
+template<typename ValueType>
+class ListIndex;
     
 template<typename ValueType>
 class Node
@@ -25,25 +81,79 @@ class Node
 public:
     template<typename> friend class CLinkedList;
     template<typename> friend class ListIterator;
+    template<typename> friend class DeferredRefCounts;
+    template<typename> friend class BorrowedIterator;
+    template<typename> friend class BorrowedRange;
+    template<typename> friend class ListIndex;
 
     using value_type = ValueType;
     using iterator = ListIterator<value_type>;
 
-    Node() = default;
+    Node() : val(), prev(nullptr), next(nullptr), deleted(false), ref_count(0), owner(ThreadSlot::current()), shared_count(0),
+        slot(NodePool<ValueType>::kNoSlot) {}
     ~Node() = default;
-    Node(ValueType value, int ref_count) : val(std::move(value)), prev(this), next(this), deleted(false), ref_count(ref_count) {}
+    Node(ValueType value, int ref_count) : val(std::move(value)), prev(this), next(this), deleted(false), ref_count(ref_count),
+        owner(ThreadSlot::current()), shared_count(0), slot(NodePool<ValueType>::kNoSlot) {}
     Node(ValueType value, CLinkedList<value_type>* list) : Node(value, 2) {}
     Node(const Node<ValueType>&) = delete;
 
     void operator=(const Node<ValueType>&) = delete;
 private:
+    static constexpr int kMerged = 1;
+    static constexpr int kQueued = 2;
+    static constexpr int kOne = 4;
+
+    static int shared_refs(int shared) {
+        return (shared - (shared & (kMerged | kQueued))) / kOne;
+    }
+
+    // Only the owner may touch ref_count, and only until the node is merged
+    bool biased() const {
+        return owner == ThreadSlot::current() && !merged;
+    }
+
     value_type val;
     Node<value_type>* prev;
     Node<value_type>* next;
     bool deleted;
+    // Lives in a NodeSlabs block rather than its own allocation
+    bool in_slab = false;
     int ref_count;
+    // The owner's own copy of kMerged, so its checks stay off shared_count
+    bool merged = false;
+    std::uint32_t owner;
+    std::atomic<int> shared_count;
+    std::uint32_t slot;
+#ifdef CLINKEDLIST_ENABLE_STATS
+    CLinkedList<value_type>* list = nullptr;
+    std::chrono::steady_clock::time_point erased_at;
+    // Zombies of a list, oldest first
+    Node<value_type>* older = nullptr;
+    Node<value_type>* newer = nullptr;
+#endif
 };
 
+// Secondary index over the elements of one list, attached with
+// CLinkedList::attach_index(). The list reports every element that joins
+// it before the element is linked in and every element that leaves it
+// while the element is still readable; added() may throw, which cancels
+// the insert, removed() must not.
+template<typename ValueType>
+class ListIndex
+{
+public:
+    virtual ~ListIndex() = default;
+
+    virtual void added(Node<ValueType>* node) = 0;
+    virtual void removed(Node<ValueType>* node) noexcept = 0;
+    // The element moved over to another node, to already holds it
+    virtual void moved(Node<ValueType>* from, Node<ValueType>* to) noexcept = 0;
+
+protected:
+    static const ValueType& value_of(const Node<ValueType>* node) noexcept {
+        return node->val;
+    }
+};
 
 template<typename ValueType>
 class CLinkedList
@@ -54,12 +164,28 @@ public:
     using iterator = ListIterator<value_type>;
 
     template<typename> friend class ListIterator;
+    template<typename> friend class DeferredRefCounts;
+    template<typename> friend class BorrowedRange;
+
+    // Default batch size of for_each_chunk
+    static constexpr size_type kChunk = 256;
+    // Defaults of for_each_prefetched and for_each_interleaved
+    static constexpr size_type kPrefetchDistance = 8;
+    static constexpr size_type kCursors = 4;
+    static constexpr size_type kMaxCursors = 16;
+
+    CLinkedList() : CLinkedList(std::numeric_limits<size_type>::max()) {}
 
-    CLinkedList() : head(nullptr), tail(nullptr), m_size(0) {
+    // Bounded list, inserting into a full one throws std::length_error
+    explicit CLinkedList(size_type capacity) : head(nullptr), tail(nullptr), m_size(0), m_capacity(capacity), m_borrows(0) {
         tail = new Node<value_type>();
         head = new Node<value_type>();
         tail->prev = head;
         head->next = tail;
+#ifdef CLINKEDLIST_ENABLE_STATS
+        tail->list = this;
+        head->list = this;
+#endif
 
         inc_ref_count(tail);
         inc_ref_count(head);
@@ -75,10 +201,24 @@ public:
     }
 
     ~CLinkedList() {
+        DeferredRefCounts<value_type>::flush();
+
+        // Live nodes may still sit in some thread's merge queue, pull them out first
+        for (auto current = head; current != nullptr; current = current->next) current->owner = kNoOwner;
+        forget_queued();
+
+#ifdef CLINKEDLIST_ENABLE_STATS
+        // Zombies can outlive the list, they must not report back to it
+        {
+            std::lock_guard<std::mutex> lock(m_zombies_mutex);
+            for (auto zombie = m_oldest_zombie; zombie != nullptr; zombie = zombie->newer) zombie->list = nullptr;
+        }
+#endif
+
         Node<value_type>* current = head;
         while (current != nullptr) {
             Node<value_type>* next = current->next;
-            delete current;
+            free_node(current);
             current = next;
         }
     }
@@ -86,38 +226,20 @@ public:
     static void dec_ref_count(Node<value_type>* ptr) {
         if (!ptr) return;
 
-        ptr->ref_count--;
-
-        if (ptr->ref_count != 0) {
-            return;
-        }
-
-        std::queue<Node<value_type>*> nodesToDelete;
-        nodesToDelete.push(ptr);
-
-        while (!nodesToDelete.empty()) {
-            auto current = nodesToDelete.front();
-
-            // Check if next node needs to be deleted
-            auto nextNode = current->next;
-            nextNode->ref_count--;
-            if (nextNode->ref_count == 0) nodesToDelete.push(nextNode);
-
-            // Check if prev node needs to be deleted
-            auto prevNode = current->next;
-            prevNode->ref_count--;
-            if (prevNode->ref_count == 0) nodesToDelete.push(prevNode);
-
-            // Delete current node
-            auto toTheGraveyard = nodesToDelete.front();
-            nodesToDelete.pop();
-            delete (toTheGraveyard);
-        }
+        if (DeferredRefCounts<value_type>::active()) [[unlikely]] DeferredRefCounts<value_type>::log(ptr, -1);
+        else dec_now(ptr);
     }
 
     static void inc_ref_count(Node<value_type>* ptr) {
         if (!ptr) return;
-        ptr->ref_count++;
+
+        if (DeferredRefCounts<value_type>::active()) [[unlikely]] DeferredRefCounts<value_type>::log(ptr, 1);
+        else inc_now(ptr);
+    }
+
+    // Settles the nodes other threads queued for this thread to merge
+    static void merge_pending() {
+        merge_pending(ThreadSlot::current());
     }
 
     CLinkedList& operator=(const CLinkedList& other) = delete;
@@ -128,8 +250,22 @@ public:
     }
      
     void push_back(value_type&& value) {
+        ListMetrics::Timer timer(m_metrics, ListMetrics::push);
         iterator it(tail, this);
-        inserts(it,value);
+        link_before(it, std::move(value));
+    }
+
+    // Backpressure without exceptions, false when the list is full
+    bool try_push_back(const value_type& value) {
+        if (m_size >= m_capacity) return false;
+        push_back(value);
+        return true;
+    }
+
+    bool try_push_back(value_type&& value) {
+        if (m_size >= m_capacity) return false;
+        push_back(std::move(value));
+        return true;
     }
 
     void push_front(const value_type& value) {
@@ -137,11 +273,363 @@ public:
     }
 
     void push_front(value_type&& value) {
+        ListMetrics::Timer timer(m_metrics, ListMetrics::push);
         iterator it(head->next, this);
-        inserts(it, value);
+        link_before(it, std::move(value));
+    }
+
+    value_type pop_front() {
+        if (empty()) throw (std::out_of_range("Invalid index"));
+
+        // Erased first, so the index still sees the value; it pins the node
+        iterator it = begin();
+        erase(it);
+        return std::move(it.ptr->val);
+    }
+
+    value_type pop_back() {
+        if (empty()) throw (std::out_of_range("Invalid index"));
+
+        iterator it(tail->prev, this);
+        erase(it);
+        return std::move(it.ptr->val);
     }
 
     iterator erase(iterator position) {
+        ListMetrics::Timer timer(m_metrics, ListMetrics::erase);
+        return unlink(position);
+    }
+
+    iterator inserts(iterator ptr, value_type value) {
+        ListMetrics::Timer timer(m_metrics, ListMetrics::insert);
+        return link_before(ptr, std::move(value));
+    }
+
+    // Moves element in front of position without freeing or copying it.
+    // Every node keeps exactly as many links pointing at it, so no ref
+    // count changes; iterators on element stay valid and follow it.
+    // Both have to be live and in this list, position may be end().
+    void splice(iterator position, iterator element) {
+        if (!position || !element || !holds(element.ptr) || !holds_or_end(position.ptr))
+            throw (std::out_of_range("Invalid index"));
+        if (m_borrows) throw (std::logic_error("List is borrowed"));
+        if (element == position || element.ptr->next == position.ptr) return;
+
+        m_waypoints.clear();
+        relink(element.ptr, position.ptr);
+    }
+
+    // Same, taking element over from other. Weak handles into other don't follow it.
+    void splice(iterator position, CLinkedList& other, iterator element) {
+        if (&other == this) return splice(position, element);
+        if (!position || !element || !other.holds(element.ptr) || !holds_or_end(position.ptr))
+            throw (std::out_of_range("Invalid index"));
+        if (m_borrows || other.m_borrows) throw (std::logic_error("List is borrowed"));
+        if (m_size >= m_capacity) throw (std::length_error("List is full"));
+
+        auto node = element.ptr;
+        auto slot = pool.attach(node);
+        if (m_index) {
+            try {
+                m_index->added(node);
+            }
+            catch (...) {
+                pool.detach(slot);
+                throw;
+            }
+        }
+        if (other.m_index) other.m_index->removed(node);
+        other.pool.detach(node->slot);
+        node->slot = slot;
+#ifdef CLINKEDLIST_ENABLE_STATS
+        node->list = this;
+#endif
+        relink(node, position.ptr);
+        other.m_size--;
+        m_size++;
+        other.m_waypoints.clear();
+        m_waypoints.clear();
+    }
+
+    void move_to_front(iterator element) {
+        splice(iterator(head->next, this), element);
+    }
+
+    iterator begin() noexcept {
+        iterator ptr(head->next, this);
+        return ptr;
+    }
+    iterator end() noexcept { 
+        iterator ptr(tail, this);
+        return ptr;
+    }
+
+    bool empty() noexcept {
+        return begin() == end();
+    }
+
+    void clear() {
+        if (m_borrows) throw (std::logic_error("List is borrowed"));
+
+        ListMetrics::Timer timer(m_metrics, ListMetrics::clear);
+        iterator current(head->next, this);
+        while (current != iterator(tail, this)) {
+            current = unlink(current);
+        }
+    }
+
+    // Weak handle to a live element, it doesn't pin the node
+    WeakHandle handle(const iterator& position) const {
+        if (!position || position.ptr->deleted || position.ptr->slot == NodePool<value_type>::kNoSlot)
+            throw (std::out_of_range("Invalid index"));
+
+        return pool.handle(position.ptr->slot);
+    }
+
+    // Iterator to the element, end() once it was erased
+    iterator resolve(const WeakHandle& handle) {
+        auto node = pool.find(handle);
+        return iterator(node ? node : tail, this);
+    }
+
+    bool contains(const WeakHandle& handle) const {
+        return pool.find(handle) != nullptr;
+    }
+
+    // Range-for without ref counting. The iterators don't pin anything, so
+    // erase() throws while the range is alive; walking still has to happen
+    // wherever walking this list is safe at all, e.g. under its lock.
+    BorrowedRange<value_type> for_each_borrowed() {
+        return BorrowedRange<value_type>(*this);
+    }
+
+    // Hands the elements to callback in order, as std::span<const value_type>
+    // batches of up to chunk values, so it can run vectorized code over
+    // them. Nodes aren't contiguous, so every batch is copied into the same
+    // buffer. Walks like for_each_borrowed(): erase() throws meanwhile.
+    template<typename F>
+    void for_each_chunk(F&& callback, size_type chunk = kChunk) {
+        if (chunk == 0) throw (std::invalid_argument("Chunk size must be positive"));
+
+        auto range = for_each_borrowed();
+        std::vector<value_type> buffer;
+        buffer.reserve(std::min(chunk, m_size));
+        for (auto& value : range) {
+            buffer.push_back(value);
+            if (buffer.size() == chunk) {
+                callback(std::span<const value_type>(buffer));
+                buffer.clear();
+            }
+        }
+        if (!buffer.empty()) callback(std::span<const value_type>(buffer));
+    }
+
+    // Same walk as for_each_borrowed(), with a second cursor running
+    // distance nodes ahead and prefetching, so the miss on a node overlaps
+    // the callback's work on the ones before it.
+    template<typename F>
+    void for_each_prefetched(F&& callback, size_type distance = kPrefetchDistance) {
+        auto range = for_each_borrowed();
+        auto ahead = head->next;
+        for (size_type i = 0; i < distance && ahead != tail; i++) {
+            prefetch(ahead->next);
+            ahead = ahead->next;
+        }
+
+        for (auto node = head->next; node != tail; node = node->next) {
+            if (ahead != tail) {
+                prefetch(ahead->next);
+                ahead = ahead->next;
+            }
+            callback(node->val);
+        }
+    }
+
+    // Moves every element that only the list's own links point at, i.e.
+    // whose node has a ref count of exactly 2, into contiguous slabs in
+    // list order, so scans walk memory front to back again. Nodes pinned by
+    // an iterator, an erased neighbour or another thread stay where they
+    // are, so every iterator still holds its element; weak handles and the
+    // attached index follow the moved ones. Returns how many moved.
+    //
+    // Only nodes whose whole count this thread can read are candidates:
+    // the ones it created, and merged ones that live on shared_count
+    // alone. A node another thread created keeps its links in that
+    // thread's plain count and stays put, even after that thread exited,
+    // so a list filled by a producer thread should be relinearized on that
+    // thread. Moved nodes belong to the calling thread afterwards.
+    size_type relinearize() {
+        if (m_borrows) throw (std::logic_error("List is borrowed"));
+        if constexpr (!NodeSlabs<Node<value_type>>::usable) return 0;
+
+        // Settle every pending count first, anything unsettled would look unpinned
+        DeferredRefCounts<value_type>::flush();
+        merge_pending();
+        m_waypoints.clear();
+
+        NodeSlabs<Node<value_type>> slabs;
+        size_type moved = 0;
+        for (auto node = head->next; node != tail;) {
+            auto next = node->next;
+            // Both counts, another thread's iterator shows up in shared_count only.
+            // A merged node has folded its plain count in, a foreign one can't be read.
+            int shared = node->shared_count.load(std::memory_order_acquire);
+            int refs = Node<value_type>::shared_refs(shared);
+            if (node->biased()) refs += node->ref_count;
+            else if (!(shared & Node<value_type>::kMerged)) refs = -1;
+            if (refs != 2 || (shared & Node<value_type>::kQueued)) {
+                node = next;
+                continue;
+            }
+
+            auto copy = slabs.construct(std::move_if_noexcept(node->val), 2);
+            copy->in_slab = true;
+            copy->slot = node->slot;
+            copy->prev = node->prev;
+            copy->next = node->next;
+            node->prev->next = copy;
+            node->next->prev = copy;
+            pool.relocate(copy->slot, copy);
+            if (m_index) m_index->moved(node, copy);
+#ifdef CLINKEDLIST_ENABLE_STATS
+            copy->list = this;
+#endif
+            free_node(node);
+            moved++;
+            node = next;
+        }
+        return moved;
+    }
+
+    // Looks up a whole batch of keys in one walk rather than one walk per
+    // key: results[i] is the first element equal to keys[i], end() if there
+    // is none. Needs std::hash of value_type.
+    std::vector<iterator> find_many(std::span<const value_type> keys) {
+        std::vector<iterator> results(keys.size(), end());
+        std::unordered_map<value_type, std::vector<size_type>> wanted;
+        for (size_type i = 0; i < keys.size(); i++) wanted[keys[i]].push_back(i);
+
+        auto range = for_each_borrowed();
+        for (auto node = head->next; node != tail && !wanted.empty(); node = node->next) {
+            auto found = wanted.find(node->val);
+            if (found == wanted.end()) continue;
+
+            for (auto i : found->second) results[i] = iterator(node, this);
+            wanted.erase(found);
+        }
+        return results;
+    }
+
+    // Visits every element once with up to kMaxCursors cursors walking
+    // separate stretches of the list in lockstep. Their misses are
+    // independent, so the memory system serves them in parallel, but the
+    // callback sees the stretches interleaved rather than in list order.
+    // The stretches start at waypoints recorded by the previous call; any
+    // insert, erase or splice drops them, and then this call walks in order
+    // and records new ones. Walks like for_each_borrowed(), and writes the
+    // waypoints, so two of these can't run at once.
+    template<typename F>
+    void for_each_interleaved(F&& callback, size_type cursors = kCursors) {
+        if (cursors == 0) throw (std::invalid_argument("Cursor count must be positive"));
+        cursors = std::min(cursors, kMaxCursors);
+        auto range = for_each_borrowed();
+
+        if (m_waypoints.size() != cursors) {
+            m_waypoints.clear();
+            size_type stride = (m_size + cursors - 1) / cursors, i = 0;
+            for (auto node = head->next; node != tail; node = node->next, i++) {
+                if (i % stride == 0 && m_waypoints.size() < cursors) m_waypoints.push_back(node);
+                callback(node->val);
+            }
+            // Short lists get empty stretches, so the count still matches next time
+            while (m_waypoints.size() < cursors) m_waypoints.push_back(tail);
+            return;
+        }
+
+        Node<value_type>* at[kMaxCursors];
+        Node<value_type>* stop[kMaxCursors];
+        for (size_type i = 0; i < cursors; i++) {
+            at[i] = m_waypoints[i];
+            stop[i] = i + 1 < cursors ? m_waypoints[i + 1] : tail;
+        }
+        for (size_type live = cursors; live > 0;) {
+            live = 0;
+            for (size_type i = 0; i < cursors; i++) {
+                if (at[i] == stop[i]) continue;
+
+                auto node = at[i];
+                at[i] = node->next;
+                prefetch(at[i]);
+                callback(node->val);
+                live++;
+            }
+        }
+    }
+
+    // Counts calls and iterator steps into metrics from now on, nullptr
+    // detaches. metrics has to outlive the list or be detached first.
+    void attach_metrics(ListMetrics* metrics) noexcept {
+        m_metrics = metrics;
+    }
+
+    // Reports the current elements and every later insert and erase to
+    // index, nullptr detaches. One index per list; it has to be detached
+    // before the list goes away.
+    void attach_index(ListIndex<value_type>* index) {
+        if (index && m_index) throw (std::logic_error("List already has an index"));
+
+        if (index) {
+            for (auto node = head->next; node != tail; node = node->next) index->added(node);
+        }
+        m_index = index;
+    }
+
+    // Walks the zombies, call it where mutating the list would be safe
+    ListStats stats() {
+        ListStats result;
+        result.live = m_size;
+#ifdef CLINKEDLIST_ENABLE_STATS
+        result.allocations = m_allocations.load(std::memory_order_relaxed);
+        result.frees = m_frees.load(std::memory_order_relaxed);
+        result.ref_count_ops = m_ref_count_ops.load(std::memory_order_relaxed);
+
+        std::lock_guard<std::mutex> lock(m_zombies_mutex);
+        if (m_oldest_zombie) result.oldest_zombie_age = std::chrono::steady_clock::now() - m_oldest_zombie->erased_at;
+
+        // Chains follow next, only start counting where no zombie points in
+        std::unordered_set<Node<value_type>*> pointed_at;
+        for (auto zombie = m_oldest_zombie; zombie != nullptr; zombie = zombie->newer) {
+            result.zombies++;
+            if (zombie->next && zombie->next->deleted) pointed_at.insert(zombie->next);
+        }
+        for (auto zombie = m_oldest_zombie; zombie != nullptr; zombie = zombie->newer) {
+            if (pointed_at.count(zombie)) continue;
+
+            size_type length = 0;
+            for (auto node = zombie; node && node->deleted; node = node->next) length++;
+            result.longest_zombie_chain = std::max(result.longest_zombie_chain, length);
+        }
+        result.zombie_bytes = result.zombies * sizeof(Node<value_type>);
+#endif
+        return result;
+    }
+
+    size_type size() const noexcept {
+        return m_size;
+    }
+
+    size_type capacity() const noexcept {
+        return m_capacity;
+    }
+
+private:
+    iterator unlink(iterator position) {
+        if (m_borrows) throw (std::logic_error("List is borrowed"));
+
+        // Pins still sitting in this thread's log must be real before anything can be freed
+        DeferredRefCounts<value_type>::flush();
+        merge_pending();
+
         auto output = iterator(position.ptr->next, this);
 
         inc_ref_count(position.ptr->next);
@@ -162,18 +650,42 @@ public:
         }
 
         m_size--;
+        m_waypoints.clear();
 
+        if (m_index) m_index->removed(position.ptr);
+        pool.detach(position.ptr->slot);
         position.ptr->deleted = true;
+#ifdef CLINKEDLIST_ENABLE_STATS
+        note_erased(position.ptr);
+#endif
         dec_ref_count(position.ptr);
         dec_ref_count(position.ptr);
 
         return output;
     }
 
-    iterator inserts(iterator ptr, value_type value) {
+    iterator link_before(iterator ptr, value_type value) {
         if (!ptr) return ptr;
-        Node<ValueType>* node = new Node<value_type>{ std::move(value), 2 };
-            
+        // One load while nothing is queued
+        merge_pending();
+        if (m_size >= m_capacity) throw (std::length_error("List is full"));
+        std::unique_ptr<Node<value_type>> owned(new Node<value_type>{ std::move(value), 2 });
+        owned->slot = pool.attach(owned.get());
+        if (m_index) {
+            try {
+                m_index->added(owned.get());
+            }
+            catch (...) {
+                pool.detach(owned->slot);
+                throw;
+            }
+        }
+        Node<ValueType>* node = owned.release();
+#ifdef CLINKEDLIST_ENABLE_STATS
+        node->list = this;
+        m_allocations.fetch_add(1, std::memory_order_relaxed);
+#endif
+
         node->prev = ptr.ptr->prev;
         node->next = ptr.ptr;
         ptr.ptr->prev->next = node;
@@ -181,37 +693,322 @@ public:
             
         iterator it(node, this);
         m_size++;
+        m_waypoints.clear();
         return it;
     }
 
-    iterator begin() noexcept {
-        iterator ptr(head->next, this);
-        return ptr;
+    // Live element of this list, erased ones have given their slot back
+    bool holds(const Node<value_type>* node) const {
+        return pool.holds(node->slot, node);
     }
-    iterator end() noexcept { 
-        iterator ptr(tail, this);
-        return ptr;
+
+    bool holds_or_end(const Node<value_type>* node) const {
+        return node == tail || holds(node);
     }
 
-    bool empty() noexcept {
-        return begin() == end();
+    static void prefetch(const void* address) noexcept {
+#if defined(_MSC_VER)
+        _mm_prefetch(static_cast<const char*>(address), _MM_HINT_T0);
+#else
+        __builtin_prefetch(address);
+#endif
     }
 
-    void clear() noexcept {
-        iterator current(head->next, this);
-        while (current != iterator(tail, this)) {
-            current = erase(current);
+    static void relink(Node<value_type>* node, Node<value_type>* before) {
+        node->prev->next = node->next;
+        node->next->prev = node->prev;
+
+        node->prev = before->prev;
+        node->next = before;
+        before->prev->next = node;
+        before->prev = node;
+    }
+
+    struct alignas(64) MergeQueue {
+        std::atomic<bool> pending{ false };
+        std::mutex mutex;
+        std::vector<Node<value_type>*> nodes;
+    };
+
+    static constexpr std::uint32_t kNoOwner = ~std::uint32_t(0);
+
+    static MergeQueue* merge_queues() {
+        static MergeQueue queues[kMaxThreads];
+        static bool hooked = (ThreadSlot::on_exit(&merge_abandoned), true);
+        (void)hooked;
+        return queues;
+    }
+
+    // Must run as the owner of slot, or as whoever adopted it
+    static void merge_pending(std::size_t slot) {
+        MergeQueue& queue = merge_queues()[slot];
+        if (!queue.pending.load(std::memory_order_acquire)) return;
+
+        std::vector<Node<value_type>*> nodes;
+        {
+            std::lock_guard<std::mutex> lock(queue.mutex);
+            nodes.swap(queue.nodes);
+            queue.pending.store(false, std::memory_order_relaxed);
+        }
+
+        for (auto node : nodes) {
+            int delta = -Node<value_type>::kQueued;
+            if (!node->merged) {
+                delta += node->ref_count * Node<value_type>::kOne + Node<value_type>::kMerged;
+                node->ref_count = 0;
+                node->merged = true;
+            }
+            int shared = node->shared_count.fetch_add(delta, std::memory_order_acq_rel) + delta;
+            if (Node<value_type>::shared_refs(shared) == 0) destroy(node);
         }
     }
 
-    size_type size() const noexcept {
-        return m_size;
+    // The owner of slot has exited, merge on its behalf while nobody else holds the slot
+    static void merge_abandoned(std::size_t slot) {
+        while (merge_queues()[slot].pending.load(std::memory_order_seq_cst) && ThreadSlot::try_adopt(slot)) {
+            merge_pending(slot);
+            ThreadSlot::release(slot);
+        }
+    }
+
+    static void forget_queued() {
+        for (std::size_t i = 0; i < kMaxThreads; i++) {
+            MergeQueue& queue = merge_queues()[i];
+            if (!queue.pending.load(std::memory_order_acquire)) continue;
+
+            std::lock_guard<std::mutex> lock(queue.mutex);
+            auto& nodes = queue.nodes;
+            nodes.erase(std::remove_if(nodes.begin(), nodes.end(), [](Node<value_type>* node) { return node->owner == kNoOwner; }), nodes.end());
+            if (nodes.empty()) queue.pending.store(false, std::memory_order_relaxed);
+        }
+    }
+
+    // First node past from along link that isn't erased. Erased nodes on the
+    // way get their link pointed straight at it, so the next iterator parked
+    // in the chain gets there in one hop, and the skipped nodes nobody else
+    // pins are freed right away. Writes to erased nodes only.
+    static Node<value_type>* skip_erased(Node<value_type>* from, Node<value_type>* Node<value_type>::* link) {
+        auto target = from->*link;
+        while (target->deleted && target->*link) target = target->*link;
+
+        // Each rewritten link hands its reference on the old node to us until
+        // we have read the old node's own link
+        Node<value_type>* held = nullptr;
+        for (auto node = from; node->*link != target;) {
+            auto old = node->*link;
+            inc_ref_count(target);
+            node->*link = target;
+            dec_ref_count(held);
+            held = old;
+            node = old;
+        }
+        dec_ref_count(held);
+
+        return target;
+    }
+
+    static void dec_now(Node<value_type>* ptr) {
+#ifdef CLINKEDLIST_ENABLE_STATS
+        if (ptr->list) ptr->list->m_ref_count_ops.fetch_add(1, std::memory_order_relaxed);
+#endif
+        // The owner dropping one of several references is a plain decrement
+        if (ptr->biased() && ptr->ref_count > 1) ptr->ref_count--;
+        else if (release(ptr)) destroy(ptr);
+    }
+
+    static void inc_now(Node<value_type>* ptr) {
+#ifdef CLINKEDLIST_ENABLE_STATS
+        if (ptr->list) ptr->list->m_ref_count_ops.fetch_add(1, std::memory_order_relaxed);
+#endif
+        if (ptr->biased()) ptr->ref_count++;
+        else ptr->shared_count.fetch_add(Node<value_type>::kOne, std::memory_order_relaxed);
+    }
+
+    // Drops one reference, true when it was the last one and ptr must go
+    static bool release(Node<value_type>* ptr) {
+        using node_type = Node<value_type>;
+
+        if (ptr->biased()) {
+            if (--ptr->ref_count != 0) return false;
+
+            ptr->merged = true;
+            int shared = ptr->shared_count.fetch_add(node_type::kMerged, std::memory_order_acq_rel) + node_type::kMerged;
+            return node_type::shared_refs(shared) == 0 && !(shared & node_type::kQueued);
+        }
+
+        int old = ptr->shared_count.load(std::memory_order_relaxed);
+        int shared;
+        do {
+            shared = old - node_type::kOne;
+            if (!(shared & node_type::kMerged) && node_type::shared_refs(shared) < 0) shared |= node_type::kQueued;
+        } while (!ptr->shared_count.compare_exchange_weak(old, shared, std::memory_order_acq_rel, std::memory_order_relaxed));
+
+        if ((shared & node_type::kQueued) && !(old & node_type::kQueued)) {
+            // Once queued the owner may free it any moment, don't touch ptr after that
+            auto owner = ptr->owner;
+            {
+                MergeQueue& queue = merge_queues()[owner];
+                std::lock_guard<std::mutex> lock(queue.mutex);
+                queue.nodes.push_back(ptr);
+                queue.pending.store(true, std::memory_order_seq_cst);
+            }
+            merge_abandoned(owner);
+            return false;
+        }
+        return (shared & node_type::kMerged) && !(shared & node_type::kQueued) && node_type::shared_refs(shared) == 0;
+    }
+
+    static void free_node(Node<value_type>* node) {
+        if (node->in_slab) NodeSlabs<Node<value_type>>::destroy(node);
+        else delete node;
+    }
+
+    // Frees ptr and everything only it kept alive
+    static void destroy(Node<value_type>* ptr) {
+        std::queue<Node<value_type>*> nodesToDelete;
+        nodesToDelete.push(ptr);
+
+        while (!nodesToDelete.empty()) {
+            auto current = nodesToDelete.front();
+
+            // Check if next node needs to be deleted
+            auto nextNode = current->next;
+            if (nextNode && release(nextNode)) nodesToDelete.push(nextNode);
+
+            // Check if prev node needs to be deleted
+            auto prevNode = current->prev;
+            if (prevNode && release(prevNode)) nodesToDelete.push(prevNode);
+
+            // Delete current node
+            auto toTheGraveyard = nodesToDelete.front();
+            nodesToDelete.pop();
+#ifdef CLINKEDLIST_ENABLE_STATS
+            if (toTheGraveyard->list) toTheGraveyard->list->note_freed(toTheGraveyard);
+#endif
+            free_node(toTheGraveyard);
+        }
     }
 
-private:
     Node<ValueType>* head; 
     Node<ValueType>* tail;
     std::queue<Node<ValueType>*> deleted_nodes;
     size_type m_size;
+    size_type m_capacity;
+    size_type m_borrows;
+    NodePool<ValueType> pool;
+    ListMetrics* m_metrics = nullptr;
+    ListIndex<value_type>* m_index = nullptr;
+    // Where for_each_interleaved's cursors start, empty once the links change
+    std::vector<Node<value_type>*> m_waypoints;
+
+#ifdef CLINKEDLIST_ENABLE_STATS
+    void note_erased(Node<value_type>* node) {
+        std::lock_guard<std::mutex> lock(m_zombies_mutex);
+        node->erased_at = std::chrono::steady_clock::now();
+        node->older = m_newest_zombie;
+        if (m_newest_zombie) m_newest_zombie->newer = node;
+        else m_oldest_zombie = node;
+        m_newest_zombie = node;
+    }
+
+    // Only erased nodes ever go through destroy()
+    void note_freed(Node<value_type>* node) {
+        m_frees.fetch_add(1, std::memory_order_relaxed);
+
+        std::lock_guard<std::mutex> lock(m_zombies_mutex);
+        if (node->older) node->older->newer = node->newer;
+        else m_oldest_zombie = node->newer;
+        if (node->newer) node->newer->older = node->older;
+        else m_newest_zombie = node->older;
+    }
+
+    std::mutex m_zombies_mutex;
+    Node<value_type>* m_oldest_zombie = nullptr;
+    Node<value_type>* m_newest_zombie = nullptr;
+    std::atomic<std::uint64_t> m_allocations{ 0 };
+    std::atomic<std::uint64_t> m_frees{ 0 };
+    std::atomic<std::uint64_t> m_ref_count_ops{ 0 };
+#endif
 };
 
+
+// Defers ref count updates made on this thread while a scope is alive.
+// Updates go to a small per-thread log where an inc and a dec on the same
+// node cancel out, so a read-only walk leaves the nodes it passes alone.
+// The net changes are applied, increments first, when the log fills up,
+// on erase(), and when the outermost scope ends; nothing is freed before.
+// Iterators made inside a scope must stay on this thread and die in it,
+// and no other thread may erase from the list while it is open.
+template<typename ValueType>
+class DeferredRefCounts
+{
+public:
+    DeferredRefCounts() { state().depth++; }
+    ~DeferredRefCounts() {
+        if (--state().depth == 0) flush();
+    }
+
+    DeferredRefCounts(const DeferredRefCounts& other) = delete;
+    DeferredRefCounts& operator=(const DeferredRefCounts& other) = delete;
+
+    static bool active() {
+        return state().depth != 0;
+    }
+
+    static void flush() {
+        State& log = state();
+        if (log.count == 0) return;
+
+        // Take the entries out first, freeing a node may log again
+        Entry entries[kLogSize];
+        std::size_t count = log.count;
+        std::copy(log.entries, log.entries + count, entries);
+        log.count = 0;
+
+        for (std::size_t i = 0; i < count; i++) {
+            for (int n = 0; n < entries[i].delta; n++) CLinkedList<ValueType>::inc_now(entries[i].node);
+        }
+        for (std::size_t i = 0; i < count; i++) {
+            for (int n = 0; n > entries[i].delta; n--) CLinkedList<ValueType>::dec_now(entries[i].node);
+        }
+    }
+
+private:
+    template<typename> friend class CLinkedList;
+
+    static constexpr std::size_t kLogSize = 64;
+    // Recent entries worth checking for a partner, walks touch few nodes at a time
+    static constexpr std::size_t kMatchWindow = 8;
+
+    struct Entry {
+        Node<ValueType>* node;
+        int delta;
+    };
+
+    struct State {
+        int depth = 0;
+        std::size_t count = 0;
+        Entry entries[kLogSize] = {};
+    };
+
+    static State& state() {
+        // Constant-initialized, so checking for an open scope is a plain TLS load
+        thread_local State log;
+        return log;
+    }
+
+    static void log(Node<ValueType>* node, int delta) {
+        State& log = state();
+
+        for (std::size_t i = log.count, seen = 0; i-- > 0 && seen < kMatchWindow; seen++) {
+            if (log.entries[i].node != node) continue;
+
+            log.entries[i].delta += delta;
+            if (log.entries[i].delta == 0) log.entries[i] = log.entries[--log.count];
+            return;
+        }
+
+        if (log.count == kLogSize) flush();
+        log.entries[log.count++] = Entry{ node, delta };
+    }
+};
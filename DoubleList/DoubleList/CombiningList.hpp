@@ -0,0 +1,156 @@
+#pragma once
+
+#include <atomic>
+#include <exception>
+#include <optional>
+#include <thread>
+#include <type_traits>
+#include <utility>
+
+#include "Iterator.cpp"
+#include "ThreadSlot.hpp"
+
+// Flat-combining wrapper around CLinkedList for heavily contended writers.
+// Every thread publishes its operation in its own slot and then tries to
+// take the combiner lock. Whoever gets it applies all pending operations in
+// one pass while the list stays hot in its cache, the others just spin on
+// their own slot until the combiner marks them done.
+//
+// Iterators returned by inserts() may be kept, copied and dropped on any
+// thread, ref counting is thread-safe. Walking or dereferencing one reads
+// the links, so that still belongs inside an operation: apply() runs any
+// closure over the list as a single combined operation.
+
+template<typename ValueType>
+class CCombiningList
+{
+public:
+    using size_type = std::size_t;
+    using value_type = ValueType;
+    using list_type = CLinkedList<value_type>;
+    using iterator = typename list_type::iterator;
+
+    CCombiningList() = default;
+    explicit CCombiningList(size_type capacity) : list(capacity) {}
+
+    CCombiningList(const CCombiningList& other) = delete;
+    CCombiningList& operator=(const CCombiningList& other) = delete;
+
+    void push_back(value_type value) {
+        apply([&](list_type& l) { l.push_back(std::move(value)); });
+    }
+
+    void push_front(value_type value) {
+        apply([&](list_type& l) { l.push_front(std::move(value)); });
+    }
+
+    iterator inserts(iterator position, value_type value) {
+        return apply([&](list_type& l) { return l.inserts(position, std::move(value)); });
+    }
+
+    void erase(iterator position) {
+        apply([&](list_type& l) { l.erase(position); });
+    }
+
+    std::optional<value_type> pop_front() {
+        return apply([](list_type& l) -> std::optional<value_type> {
+            if (l.empty()) return std::nullopt;
+            return l.pop_front();
+        });
+    }
+
+    std::optional<value_type> pop_back() {
+        return apply([](list_type& l) -> std::optional<value_type> {
+            if (l.empty()) return std::nullopt;
+            return l.pop_back();
+        });
+    }
+
+    size_type size() {
+        return apply([](list_type& l) { return l.size(); });
+    }
+
+    // Runs f(list) as one combined operation and hands back its result.
+    // Exceptions thrown by f are rethrown on the calling thread.
+    template<typename F>
+    auto apply(F&& f) -> decltype(f(std::declval<list_type&>())) {
+        using result_type = decltype(f(std::declval<list_type&>()));
+        Operation<F, result_type> op(f);
+
+        auto index = ThreadSlot::current();
+        auto used = m_slots_used.load(std::memory_order_relaxed);
+        while (used <= index && !m_slots_used.compare_exchange_weak(used, index + 1, std::memory_order_relaxed)) {}
+
+        slots[index].pending.store(&op, std::memory_order_release);
+
+        for (unsigned spins = 0; !op.done.load(std::memory_order_acquire); spins++) {
+            if (!m_locked.load(std::memory_order_relaxed) && !m_locked.exchange(true, std::memory_order_acquire)) {
+                combine();
+                m_locked.store(false, std::memory_order_release);
+            }
+            else if (spins > kSpinsBeforeYield) {
+                std::this_thread::yield();
+            }
+        }
+
+        return op.result();
+    }
+
+private:
+    static constexpr unsigned kSpinsBeforeYield = 64;
+    static constexpr int kCombinePasses = 2;
+
+    struct Request {
+        void (*run)(Request*, list_type&);
+        std::atomic<bool> done{ false };
+    };
+
+    template<typename F, typename R>
+    struct Operation : Request {
+        explicit Operation(F& f) : f(f) { this->run = &Operation::execute; }
+
+        static void execute(Request* request, list_type& l) {
+            auto self = static_cast<Operation*>(request);
+            try {
+                if constexpr (std::is_void<R>::value) self->f(l);
+                else self->value.emplace(self->f(l));
+            }
+            catch (...) {
+                self->error = std::current_exception();
+            }
+        }
+
+        R result() {
+            if (error) std::rethrow_exception(error);
+            if constexpr (!std::is_void<R>::value) return std::move(*value);
+        }
+
+        F& f;
+        std::optional<std::conditional_t<std::is_void<R>::value, char, R>> value;
+        std::exception_ptr error;
+    };
+
+    struct alignas(64) Slot {
+        std::atomic<Request*> pending{ nullptr };
+    };
+
+    // A couple of passes so requests published mid-scan still ride along
+    void combine() {
+        for (int pass = 0; pass < kCombinePasses; pass++) {
+            auto used = m_slots_used.load(std::memory_order_acquire);
+            for (size_type i = 0; i < used; i++) {
+                auto request = slots[i].pending.load(std::memory_order_acquire);
+                if (!request) continue;
+
+                slots[i].pending.store(nullptr, std::memory_order_relaxed);
+                request->run(request, list);
+                request->done.store(true, std::memory_order_release);
+            }
+        }
+    }
+
+    Slot slots[kMaxThreads];
+    alignas(64) std::atomic<size_type> m_slots_used{ 0 };
+    alignas(64) std::atomic<bool> m_locked{ false };
+    alignas(64) list_type list;
+};
@@ -0,0 +1,343 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <limits>
+#include <optional>
+#include <type_traits>
+#include <utility>
+
+#include "EpochReclamation.hpp"
+#include "Futex.hpp"
+
+// Lock-free FIFO counterpart of CLinkedList (Michael & Scott queue).
+// head is a dummy sentinel just like in CLinkedList, the first element lives
+// in head->next; tail points at the last node or lags one step behind it.
+// Only push_back/pop_front are lock-free, the algorithm has no safe way to
+// work on both ends, so there is no push_front/pop_back here.
+//
+// The Policy picks how many threads may sit on each end:
+//   MPMC - any thread pushes and pops (CAS loops, epoch reclamation)
+//   MPSC - any thread pushes with a single exchange, one thread pops
+//   SPSC - one pusher, one popper, wait-free with plain loads and stores
+// With a single consumer nobody else can still be reading the old dummy,
+// so the consumer deletes it directly instead of retiring it.
+//
+// Consumers that would rather sleep than spin on empty() use wait_pop() or
+// try_pop_for(); they park on an EventCount and every push_back wakes at
+// most one of them.
+//
+// An optional capacity bounds the list. A slot is reserved in m_size (a CAS
+// loop, no lock) before the node is linked, try_push_back gives up when the
+// list is full, push_back parks until a pop frees a slot and push_back_for
+// parks with a deadline. SPSC compares its two single-writer counters
+// instead, and unbounded MPSC still skips the counter altogether.
+
+struct MPMC {};
+struct MPSC {};
+struct SPSC {};
+
+template<typename ValueType>
+class ConcurrentNode
+{
+public:
+    template<typename, typename> friend class CConcurrentList;
+
+    ConcurrentNode() : val(), next(nullptr) {}
+    explicit ConcurrentNode(ValueType value) : val(std::move(value)), next(nullptr) {}
+    ConcurrentNode(const ConcurrentNode&) = delete;
+
+    void operator=(const ConcurrentNode&) = delete;
+private:
+    ValueType val;
+    std::atomic<ConcurrentNode*> next;
+};
+
+
+template<typename ValueType, typename Policy = MPMC>
+class CConcurrentList
+{
+public:
+    using size_type = std::size_t;
+    using value_type = ValueType;
+    using policy = Policy;
+
+    static constexpr bool single_producer = std::is_same<Policy, SPSC>::value;
+    static constexpr bool single_consumer = std::is_same<Policy, SPSC>::value || std::is_same<Policy, MPSC>::value;
+    static constexpr size_type unbounded = std::numeric_limits<size_type>::max();
+
+    CConcurrentList() : CConcurrentList(unbounded) {}
+
+    explicit CConcurrentList(size_type capacity) :
+        head(nullptr), m_popped(0), tail(nullptr), m_pushed(0), m_size(0), m_capacity(capacity) {
+        auto dummy = new ConcurrentNode<value_type>();
+        head.store(dummy, std::memory_order_relaxed);
+        tail.store(dummy, std::memory_order_relaxed);
+    }
+
+    CConcurrentList(const CConcurrentList& other) = delete;
+    CConcurrentList(CConcurrentList&& x) = delete;
+    CConcurrentList(std::initializer_list<value_type> l) : CConcurrentList() {
+        for (auto i = l.begin(); i < l.end(); i++)
+            push_back(*i);
+    }
+
+    // Not thread-safe, every producer and consumer has to be finished
+    ~CConcurrentList() {
+        auto current = head.load(std::memory_order_relaxed);
+        while (current != nullptr) {
+            auto next = current->next.load(std::memory_order_relaxed);
+            delete current;
+            current = next;
+        }
+    }
+
+    CConcurrentList& operator=(const CConcurrentList& other) = delete;
+    CConcurrentList& operator=(CConcurrentList&& x) = delete;
+
+    void push_back(const value_type& value) {
+        push_back(value_type(value));
+    }
+
+    // Blocks while the list is full
+    void push_back(value_type&& value) {
+        while (!try_reserve()) {
+            auto key = m_not_full.prepare_wait();
+            if (try_reserve()) {
+                m_not_full.cancel_wait();
+                break;
+            }
+            m_not_full.wait(key);
+        }
+        link(new ConcurrentNode<value_type>(std::move(value)));
+    }
+
+    bool try_push_back(const value_type& value) {
+        if (!try_reserve()) return false;
+        link(new ConcurrentNode<value_type>(value));
+        return true;
+    }
+
+    // value is left untouched when the list is full
+    bool try_push_back(value_type&& value) {
+        if (!try_reserve()) return false;
+        link(new ConcurrentNode<value_type>(std::move(value)));
+        return true;
+    }
+
+    template<typename Rep, typename Period>
+    bool push_back_for(const value_type& value, const std::chrono::duration<Rep, Period>& timeout) {
+        value_type copy(value);
+        return push_back_for(std::move(copy), timeout);
+    }
+
+    template<typename Rep, typename Period>
+    bool push_back_for(value_type&& value, const std::chrono::duration<Rep, Period>& timeout) {
+        auto deadline = std::chrono::steady_clock::now() + timeout;
+        while (!try_reserve()) {
+            auto key = m_not_full.prepare_wait();
+            if (try_reserve()) {
+                m_not_full.cancel_wait();
+                break;
+            }
+            if (!m_not_full.wait_until(key, deadline)) {
+                if (!try_reserve()) return false;
+                break;
+            }
+        }
+        link(new ConcurrentNode<value_type>(std::move(value)));
+        return true;
+    }
+
+    std::optional<value_type> pop_front() {
+        std::optional<value_type> value;
+        if constexpr (single_consumer) {
+            auto first = head.load(std::memory_order_relaxed);
+            auto next = first->next.load(std::memory_order_acquire);
+            if (next == nullptr) return std::nullopt;
+
+            value.emplace(std::move(next->val));
+            head.store(next, std::memory_order_relaxed);
+            delete first;
+        }
+        else {
+            value = pop_front_mpmc();
+            if (!value) return value;
+        }
+
+        release();
+        return value;
+    }
+
+    // Blocks until an element shows up
+    value_type wait_pop() {
+        while (true) {
+            if (auto value = pop_front()) return std::move(*value);
+
+            auto key = m_not_empty.prepare_wait();
+            if (auto value = pop_front()) {
+                m_not_empty.cancel_wait();
+                return std::move(*value);
+            }
+            m_not_empty.wait(key);
+        }
+    }
+
+    template<typename Rep, typename Period>
+    std::optional<value_type> try_pop_for(const std::chrono::duration<Rep, Period>& timeout) {
+        auto deadline = std::chrono::steady_clock::now() + timeout;
+        while (true) {
+            if (auto value = pop_front()) return value;
+
+            auto key = m_not_empty.prepare_wait();
+            if (auto value = pop_front()) {
+                m_not_empty.cancel_wait();
+                return value;
+            }
+            if (!m_not_empty.wait_until(key, deadline)) return pop_front();
+        }
+    }
+
+    // Single consumer variants may only ask this from the consumer thread
+    bool empty() const noexcept {
+        if constexpr (single_consumer) {
+            return head.load(std::memory_order_relaxed)->next.load(std::memory_order_acquire) == nullptr;
+        }
+        else {
+            EpochGuard guard;
+            return head.load(std::memory_order_acquire)->next.load(std::memory_order_acquire) == nullptr;
+        }
+    }
+
+    // Exact when quiescent, a snapshot otherwise. Counts reserved slots too,
+    // so a producer between reserving and linking is already included.
+    size_type size() const noexcept {
+        static_assert(!std::is_same<Policy, MPSC>::value, "MPSC keeps no counter, a push is a single exchange");
+
+        if constexpr (single_producer) {
+            auto popped = m_popped.load(std::memory_order_acquire);
+            return m_pushed.load(std::memory_order_acquire) - popped;
+        }
+        else {
+            return m_size.load(std::memory_order_relaxed);
+        }
+    }
+
+    size_type capacity() const noexcept {
+        return m_capacity;
+    }
+
+private:
+    bool try_reserve() {
+        if constexpr (single_producer) {
+            if (m_capacity == unbounded) return true;
+            auto popped = m_popped.load(std::memory_order_acquire);
+            return m_pushed.load(std::memory_order_relaxed) - popped < m_capacity;
+        }
+        else {
+            if (m_capacity == unbounded) {
+                // MPSC stays at a single exchange per push when nothing is bounded
+                if constexpr (!single_consumer) m_size.fetch_add(1, std::memory_order_relaxed);
+                return true;
+            }
+
+            auto current = m_size.load(std::memory_order_relaxed);
+            do {
+                if (current >= m_capacity) return false;
+            } while (!m_size.compare_exchange_weak(current, current + 1, std::memory_order_relaxed));
+            return true;
+        }
+    }
+
+    // Gives back the slot of a popped element and wakes one blocked producer
+    void release() {
+        if constexpr (single_producer) {
+            m_popped.store(m_popped.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+        }
+        else if constexpr (single_consumer) {
+            if (m_capacity == unbounded) return;
+            m_size.fetch_sub(1, std::memory_order_relaxed);
+        }
+        else {
+            m_size.fetch_sub(1, std::memory_order_relaxed);
+        }
+
+        if (m_capacity != unbounded) m_not_full.notify_one();
+    }
+
+    // The slot is already reserved, so the count never goes below zero
+    void link(ConcurrentNode<value_type>* node) {
+        if constexpr (single_producer) {
+            // tail is ours alone, the consumer only frees a node after its next is set
+            tail.load(std::memory_order_relaxed)->next.store(node, std::memory_order_release);
+            tail.store(node, std::memory_order_relaxed);
+            m_pushed.store(m_pushed.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+        }
+        else if constexpr (single_consumer) {
+            // Between the exchange and the store the queue looks cut short,
+            // the consumer just sees it as empty for that moment
+            auto prev = tail.exchange(node, std::memory_order_acq_rel);
+            prev->next.store(node, std::memory_order_release);
+        }
+        else {
+            link_mpmc(node);
+        }
+        m_not_empty.notify_one();
+    }
+
+    void link_mpmc(ConcurrentNode<value_type>* node) {
+        EpochGuard guard;
+        while (true) {
+            auto last = tail.load(std::memory_order_acquire);
+            auto next = last->next.load(std::memory_order_acquire);
+            if (last != tail.load(std::memory_order_acquire)) continue;
+
+            if (next == nullptr) {
+                if (last->next.compare_exchange_weak(next, node, std::memory_order_release, std::memory_order_relaxed)) {
+                    tail.compare_exchange_strong(last, node, std::memory_order_release, std::memory_order_relaxed);
+                    return;
+                }
+            }
+            else {
+                // Another producer linked a node but hasn't swung tail yet, help it
+                tail.compare_exchange_weak(last, next, std::memory_order_release, std::memory_order_relaxed);
+            }
+        }
+    }
+
+    std::optional<value_type> pop_front_mpmc() {
+        EpochGuard guard;
+        while (true) {
+            auto first = head.load(std::memory_order_acquire);
+            auto last = tail.load(std::memory_order_acquire);
+            auto next = first->next.load(std::memory_order_acquire);
+            if (first != head.load(std::memory_order_acquire)) continue;
+
+            if (next == nullptr) return std::nullopt;
+
+            if (first == last) {
+                tail.compare_exchange_weak(last, next, std::memory_order_release, std::memory_order_relaxed);
+                continue;
+            }
+
+            if (head.compare_exchange_weak(first, next, std::memory_order_acq_rel, std::memory_order_relaxed)) {
+                // next is the new dummy, nobody else reads its value
+                std::optional<value_type> value(std::move(next->val));
+                EpochDomain::global().retire(first);
+                return value;
+            }
+        }
+    }
+
+    // Consumer side
+    alignas(64) std::atomic<ConcurrentNode<value_type>*> head;
+    std::atomic<size_type> m_popped;    // SPSC
+    // Producer side
+    alignas(64) std::atomic<ConcurrentNode<value_type>*> tail;
+    std::atomic<size_type> m_pushed;    // SPSC
+    alignas(64) std::atomic<size_type> m_size;    // MPMC, bounded MPSC
+    const size_type m_capacity;
+    alignas(64) EventCount m_not_empty;
+    alignas(64) EventCount m_not_full;
+};
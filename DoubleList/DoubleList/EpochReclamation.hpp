@@ -0,0 +1,126 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <vector>
+
+#include "ThreadSlot.hpp"
+
+// Epoch based reclamation for the lock-free containers.
+// Readers pin the current epoch with EpochGuard, writers retire unlinked
+// nodes instead of deleting them. A node retired in epoch e is freed once
+// the global epoch reaches e + 2, when no guard can still see it.
+class EpochDomain
+{
+public:
+    static EpochDomain& global() {
+        static EpochDomain domain;
+        return domain;
+    }
+
+    EpochDomain() = default;
+    EpochDomain(const EpochDomain&) = delete;
+    EpochDomain& operator=(const EpochDomain&) = delete;
+
+    // Frees everything still pending, no guard may be active here
+    ~EpochDomain() {
+        for (auto& rec : records) {
+            for (auto& r : rec.retired) r.deleter(r.ptr);
+        }
+    }
+
+    void enter() {
+        Record& rec = records[ThreadSlot::current()];
+        if (rec.nesting++ == 0) {
+            rec.epoch.store(global_epoch.load(std::memory_order_relaxed), std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+        }
+    }
+
+    void exit() {
+        Record& rec = records[ThreadSlot::current()];
+        if (--rec.nesting == 0) {
+            rec.epoch.store(kInactive, std::memory_order_release);
+        }
+    }
+
+    template<typename T>
+    void retire(T* ptr) {
+        retire(ptr, [](void* p) { delete static_cast<T*>(p); });
+    }
+
+    void retire(void* ptr, void (*deleter)(void*)) {
+        Record& rec = records[ThreadSlot::current()];
+        rec.retired.push_back({ ptr, deleter, global_epoch.load(std::memory_order_acquire) });
+        if (rec.retired.size() >= kCollectThreshold) {
+            collect(rec);
+        }
+    }
+
+    // Tries to free this thread's retired nodes right away
+    void collect() {
+        collect(records[ThreadSlot::current()]);
+    }
+
+private:
+    static constexpr std::uint64_t kInactive = ~std::uint64_t(0);
+    static constexpr std::size_t kCollectThreshold = 64;
+
+    struct Retired {
+        void* ptr;
+        void (*deleter)(void*);
+        std::uint64_t epoch;
+    };
+
+    struct alignas(64) Record {
+        std::atomic<std::uint64_t> epoch{ kInactive };
+        unsigned nesting = 0;
+        std::vector<Retired> retired;
+    };
+
+    bool try_advance() {
+        std::uint64_t current = global_epoch.load(std::memory_order_acquire);
+        for (auto& rec : records) {
+            std::uint64_t seen = rec.epoch.load(std::memory_order_acquire);
+            if (seen != kInactive && seen != current) return false;
+        }
+        return global_epoch.compare_exchange_strong(current, current + 1, std::memory_order_acq_rel);
+    }
+
+    void collect(Record& rec) {
+        try_advance();
+        std::uint64_t current = global_epoch.load(std::memory_order_acquire);
+
+        std::size_t kept = 0;
+        for (std::size_t i = 0; i < rec.retired.size(); i++) {
+            if (rec.retired[i].epoch + 2 <= current) {
+                rec.retired[i].deleter(rec.retired[i].ptr);
+            }
+            else {
+                rec.retired[kept++] = rec.retired[i];
+            }
+        }
+        rec.retired.resize(kept);
+    }
+
+    alignas(64) std::atomic<std::uint64_t> global_epoch{ 0 };
+    Record records[kMaxThreads];
+};
+
+// Pins the current epoch for the lifetime of the scope
+class EpochGuard
+{
+public:
+    explicit EpochGuard(EpochDomain& domain = EpochDomain::global()) : domain(domain) {
+        domain.enter();
+    }
+    ~EpochGuard() {
+        domain.exit();
+    }
+
+    EpochGuard(const EpochGuard&) = delete;
+    EpochGuard& operator=(const EpochGuard&) = delete;
+
+private:
+    EpochDomain& domain;
+};
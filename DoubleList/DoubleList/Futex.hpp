@@ -0,0 +1,162 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <thread>
+
+#if defined(_WIN32)
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#pragma comment(lib, "Synchronization.lib")
+#elif defined(__linux__)
+#include <climits>
+#include <ctime>
+#include <linux/futex.h>
+#include <linux/membarrier.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+// Thin wrappers over the OS "sleep while this word equals x" primitive:
+// futex on Linux, WaitOnAddress on Windows, a polling loop anywhere else.
+// Waits may return spuriously, callers always re-check their condition.
+
+inline void futex_wait_for(std::atomic<std::uint32_t>& word, std::uint32_t expected, std::chrono::nanoseconds timeout) {
+    if (timeout.count() <= 0) return;
+#if defined(_WIN32)
+    auto ms = std::chrono::ceil<std::chrono::milliseconds>(timeout).count();
+    WaitOnAddress(&word, &expected, sizeof(expected), ms >= INFINITE ? INFINITE - 1 : static_cast<DWORD>(ms));
+#elif defined(__linux__)
+    timespec ts;
+    ts.tv_sec = static_cast<time_t>(timeout.count() / 1000000000);
+    ts.tv_nsec = static_cast<long>(timeout.count() % 1000000000);
+    syscall(SYS_futex, reinterpret_cast<std::uint32_t*>(&word), FUTEX_WAIT_PRIVATE, expected, &ts, nullptr, 0);
+#else
+    if (word.load(std::memory_order_acquire) == expected)
+        std::this_thread::sleep_for(std::min<std::chrono::nanoseconds>(timeout, std::chrono::microseconds(50)));
+#endif
+}
+
+inline void futex_wait(std::atomic<std::uint32_t>& word, std::uint32_t expected) {
+#if defined(_WIN32)
+    WaitOnAddress(&word, &expected, sizeof(expected), INFINITE);
+#elif defined(__linux__)
+    syscall(SYS_futex, reinterpret_cast<std::uint32_t*>(&word), FUTEX_WAIT_PRIVATE, expected, nullptr, nullptr, 0);
+#else
+    futex_wait_for(word, expected, std::chrono::microseconds(50));
+#endif
+}
+
+inline void futex_wake_one(std::atomic<std::uint32_t>& word) {
+#if defined(_WIN32)
+    WakeByAddressSingle(&word);
+#elif defined(__linux__)
+    syscall(SYS_futex, reinterpret_cast<std::uint32_t*>(&word), FUTEX_WAKE_PRIVATE, 1, nullptr, nullptr, 0);
+#endif
+}
+
+inline void futex_wake_all(std::atomic<std::uint32_t>& word) {
+#if defined(_WIN32)
+    WakeByAddressAll(&word);
+#elif defined(__linux__)
+    syscall(SYS_futex, reinterpret_cast<std::uint32_t*>(&word), FUTEX_WAKE_PRIVATE, INT_MAX, nullptr, nullptr, 0);
+#endif
+}
+
+// Process-wide barrier: every thread of the process runs a full fence
+// before this returns (membarrier on Linux, FlushProcessWriteBuffers on
+// Windows). Where that exists, a seq_cst fence on one side of a Dekker
+// style handshake can become a compiler barrier, asymmetric_light_fence(),
+// as long as the other side calls this; elsewhere both are seq_cst fences.
+inline bool asymmetric_fences() {
+#if defined(_WIN32)
+    return true;
+#elif defined(__linux__) && defined(MEMBARRIER_CMD_PRIVATE_EXPEDITED)
+    static const bool registered = syscall(SYS_membarrier, MEMBARRIER_CMD_REGISTER_PRIVATE_EXPEDITED, 0, 0) == 0;
+    return registered;
+#else
+    return false;
+#endif
+}
+
+inline void asymmetric_heavy_fence() {
+    if (!asymmetric_fences()) {
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        return;
+    }
+#if defined(_WIN32)
+    FlushProcessWriteBuffers();
+#elif defined(__linux__) && defined(MEMBARRIER_CMD_PRIVATE_EXPEDITED)
+    syscall(SYS_membarrier, MEMBARRIER_CMD_PRIVATE_EXPEDITED, 0, 0);
+#endif
+}
+
+inline void asymmetric_light_fence() {
+    if (asymmetric_fences()) std::atomic_signal_fence(std::memory_order_seq_cst);
+    else std::atomic_thread_fence(std::memory_order_seq_cst);
+}
+
+// Lets threads sleep until "something changed" without a mutex.
+// A waiter takes a key with prepare_wait(), re-checks its condition, and
+// then either cancel_wait()s or sleeps in wait(key). The notifier publishes
+// its change first and calls notify_one(). The waiter count keeps the epoch
+// bump and the wake-up off the notifier while nobody is waiting, and the
+// waiter takes the heavy side of the fence, so the notifier then pays one
+// load.
+class EventCount
+{
+public:
+    std::uint32_t prepare_wait() {
+        m_waiters.fetch_add(1, std::memory_order_seq_cst);
+        asymmetric_heavy_fence();
+        return m_epoch.load(std::memory_order_seq_cst);
+    }
+
+    void cancel_wait() {
+        m_waiters.fetch_sub(1, std::memory_order_relaxed);
+    }
+
+    void wait(std::uint32_t key) {
+        while (m_epoch.load(std::memory_order_acquire) == key) {
+            futex_wait(m_epoch, key);
+        }
+        m_waiters.fetch_sub(1, std::memory_order_relaxed);
+    }
+
+    // false if the deadline passed without a notification
+    template<typename Clock, typename Duration>
+    bool wait_until(std::uint32_t key, const std::chrono::time_point<Clock, Duration>& deadline) {
+        while (m_epoch.load(std::memory_order_acquire) == key) {
+            auto now = Clock::now();
+            if (now >= deadline) {
+                m_waiters.fetch_sub(1, std::memory_order_relaxed);
+                return false;
+            }
+            futex_wait_for(m_epoch, key, deadline - now);
+        }
+        m_waiters.fetch_sub(1, std::memory_order_relaxed);
+        return true;
+    }
+
+    void notify_one() {
+        asymmetric_light_fence();
+        if (m_waiters.load(std::memory_order_relaxed) == 0) return;
+        m_epoch.fetch_add(1, std::memory_order_seq_cst);
+        futex_wake_one(m_epoch);
+    }
+
+    void notify_all() {
+        asymmetric_light_fence();
+        if (m_waiters.load(std::memory_order_relaxed) == 0) return;
+        m_epoch.fetch_add(1, std::memory_order_seq_cst);
+        futex_wake_all(m_epoch);
+    }
+
+private:
+    std::atomic<std::uint32_t> m_epoch{ 0 };
+    std::atomic<std::uint32_t> m_waiters{ 0 };
+};
@@ -0,0 +1,183 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "Iterator.cpp"
+
+// Indexes a list by the element itself
+struct IdentityKey
+{
+    template<typename T>
+    const T& operator()(const T& value) const noexcept {
+        return value;
+    }
+};
+
+// Hash index over a CLinkedList, kept up to date by every insert, erase
+// and splice of the list. find() hashes its way straight to the node and
+// only pins the one it returns, where a linear search pins every node it
+// passes.
+//
+// Keys come from key_of(element). Open addressing with linear probing over
+// a flat table of node pointers and their hashes, so indexing an element
+// allocates nothing beyond the occasional rehash. Elements with equal keys
+// are all indexed; find() returns any one of them.
+//
+// An element's key must not change while it is in the list. The index
+// attaches itself on construction and detaches on destruction, so it has
+// to go before the list does.
+template<typename ValueType, typename KeyOf = IdentityKey,
+    typename Hash = std::hash<std::decay_t<std::invoke_result_t<const KeyOf&, const ValueType&>>>>
+class CHashIndex : public ListIndex<ValueType>
+{
+public:
+    using size_type = std::size_t;
+    using value_type = ValueType;
+    using key_type = std::decay_t<std::invoke_result_t<const KeyOf&, const ValueType&>>;
+    using iterator = ListIterator<value_type>;
+
+    explicit CHashIndex(CLinkedList<value_type>& list, KeyOf key_of = KeyOf(), Hash hash = Hash()) :
+        list(list), key_of(std::move(key_of)), hash(std::move(hash)), m_size(0), m_used(0) {
+        rehash(list.size());
+        list.attach_index(this);
+    }
+
+    ~CHashIndex() override {
+        list.attach_index(nullptr);
+    }
+
+    CHashIndex(const CHashIndex& other) = delete;
+    CHashIndex& operator=(const CHashIndex& other) = delete;
+
+    // end() of the list when no element has key
+    iterator find(const key_type& key) {
+        auto node = lookup(key);
+        return node ? iterator(node, &list) : list.end();
+    }
+
+    bool contains(const key_type& key) const {
+        return lookup(key) != nullptr;
+    }
+
+    size_type count(const key_type& key) const {
+        if (m_size == 0) return 0;
+
+        size_type found = 0;
+        auto h = hash(key);
+        for (auto i = home(h);; i = (i + 1) & mask()) {
+            const Entry& entry = table[i];
+            if (entry.empty()) return found;
+            if (entry.node && entry.hash == h && key_of(this->value_of(entry.node)) == key) found++;
+        }
+    }
+
+    size_type size() const noexcept {
+        return m_size;
+    }
+
+    void added(Node<value_type>* node) override {
+        // Grows before touching the table, so a failed insert leaves it as it was
+        if ((m_used + 1) * 4 > table.size() * 3) rehash(m_size + 1);
+
+        auto h = hash(key_of(this->value_of(node)));
+        auto i = home(h);
+        while (table[i].node) i = (i + 1) & mask();
+        if (table[i].empty()) m_used++;
+        table[i] = Entry{ node, h };
+        m_size++;
+    }
+
+    void removed(Node<value_type>* node) noexcept override {
+        auto h = hash(key_of(this->value_of(node)));
+        for (auto i = home(h);; i = (i + 1) & mask()) {
+            Entry& entry = table[i];
+            if (entry.empty()) return;
+            if (entry.node == node) {
+                entry = Entry{ nullptr, kTombstone };
+                m_size--;
+                return;
+            }
+        }
+    }
+
+    void moved(Node<value_type>* from, Node<value_type>* to) noexcept override {
+        auto h = hash(key_of(this->value_of(to)));
+        for (auto i = home(h);; i = (i + 1) & mask()) {
+            Entry& entry = table[i];
+            if (entry.empty()) return;
+            if (entry.node == from) {
+                entry.node = to;
+                return;
+            }
+        }
+    }
+
+private:
+    // A free slot has no node; its hash tells whether probing may stop there
+    static constexpr std::size_t kTombstone = 1;
+
+    struct Entry {
+        Node<value_type>* node = nullptr;
+        std::size_t hash = 0;
+
+        bool empty() const noexcept {
+            return !node && hash != kTombstone;
+        }
+    };
+
+    Node<value_type>* lookup(const key_type& key) const {
+        if (m_size == 0) return nullptr;
+
+        auto h = hash(key);
+        for (auto i = home(h);; i = (i + 1) & mask()) {
+            const Entry& entry = table[i];
+            if (entry.empty()) return nullptr;
+            if (entry.node && entry.hash == h && key_of(this->value_of(entry.node)) == key) return entry.node;
+        }
+    }
+
+    // Fibonacci hashing, std::hash is the identity for integers
+    size_type home(std::size_t h) const noexcept {
+        return static_cast<size_type>((static_cast<std::uint64_t>(h) * 0x9E3779B97F4A7C15ull) >> m_shift);
+    }
+
+    size_type mask() const noexcept {
+        return table.size() - 1;
+    }
+
+    // Room for at least elements at under half load, tombstones dropped
+    void rehash(size_type elements) {
+        size_type capacity = 16;
+        int bits = 4;
+        while (capacity < elements * 2) {
+            capacity *= 2;
+            bits++;
+        }
+
+        std::vector<Entry> old(capacity);
+        old.swap(table);
+        m_shift = 64 - bits;
+        m_used = m_size;
+        for (auto& entry : old) {
+            if (!entry.node) continue;
+
+            auto i = home(entry.hash);
+            while (table[i].node) i = (i + 1) & mask();
+            table[i] = entry;
+        }
+    }
+
+    CLinkedList<value_type>& list;
+    KeyOf key_of;
+    Hash hash;
+    std::vector<Entry> table;
+    size_type m_size;
+    // Live entries plus tombstones
+    size_type m_used;
+    int m_shift = 64;
+};
@@ -29,17 +29,16 @@ public:
         if (!ptr) return;
 
         CLinkedList<ValueType>::dec_ref_count(ptr);
-        if (ptr->ref_count == 0) {
-            ptr = nullptr;
-        }
+        ptr = nullptr;
     }
 
     ListIterator& operator=(const  ListIterator& other) {
+        // Pin the new node first so self-assignment can't free it
+        CLinkedList<ValueType>::inc_ref_count(other.ptr);
         CLinkedList<ValueType>::dec_ref_count(ptr);
 
         this->ptr = other.ptr;
-
-        CLinkedList<ValueType>::inc_ref_count(ptr);
+        this->list = other.list;
 
         return *this;
     }
@@ -59,68 +58,35 @@ public:
     // prefix ++
     ListIterator& operator++() {
         if (!ptr->next) throw (std::out_of_range("Invalid index"));
+        if (list && list->m_metrics) list->m_metrics->count(ListMetrics::step);
 
-        *this = ListIterator(this->ptr->next, list);
-
-        if (ptr) {
-            while (this->ptr->deleted && ptr->next) {
-                *this = ListIterator(this->ptr->next, list);
-            }
-        }
+        move_to(CLinkedList<ValueType>::skip_erased(ptr, &Node<value_type>::next));
 
         return *this;
-
     }
 
     // postfix ++
     ListIterator operator++(int) {
-        if (!ptr->next) throw (std::out_of_range("Invalid index"));
-
-        ListIterator new_ptr(*this);
-
-        if (new_ptr.ptr->next) {
-
-            *this = ListIterator(new_ptr.ptr->next, list);
-
-            while (ptr->deleted && ptr->next) {
-                *this = ListIterator(this->ptr->next, list);
-            }
-        }
-
-        //return new_ptr.ptr;
-        return ListIterator(new_ptr.ptr, list);
+        ListIterator old(*this);
+        ++*this;
+        return old;
     }
 
     // prefix --
     ListIterator& operator--() {
         if (!ptr->prev->prev) throw std::out_of_range("Invalid index");
+        if (list && list->m_metrics) list->m_metrics->count(ListMetrics::step);
 
-        *this = ListIterator(this->ptr->prev, list);
-
-        if (ptr) {
-            while (this->ptr->deleted && ptr->prev) {
-                *this = ListIterator(this->ptr->prev, list);
-            }
-        }
+        move_to(CLinkedList<ValueType>::skip_erased(ptr, &Node<value_type>::prev));
 
         return *this;
     }
 
     // postfix --
     ListIterator operator--(int) {
-        if (!ptr->prev->prev) throw std::out_of_range("Invalid index");
-
-        ListIterator new_ptr(*this);
-
-        if (new_ptr.ptr->prev) {
-            *this = ListIterator(new_ptr.ptr->prev, list);
-            while (ptr->deleted && ptr->prev)
-            {
-                *this = ListIterator(this->ptr->prev, list);
-            }
-        }
-
-        return ListIterator(new_ptr.ptr, list);
+        ListIterator old(*this);
+        --*this;
+        return old;
     }
 
     friend bool operator==(const ListIterator<ValueType>& a, const ListIterator<ValueType>& b) {
@@ -135,12 +101,105 @@ public:
         return ptr;
     }
 
+    // The element was erased, the iterator only keeps its node around
+    bool is_erased() const {
+        return ptr->deleted;
+    }
+
+    // Owner's biased part plus everybody else's, exact when nobody races
     int getRefCount()
     {
-        return ptr->ref_count;
+        return ptr->ref_count + Node<ValueType>::shared_refs(ptr->shared_count.load(std::memory_order_acquire));
+    }
+
+private:
+    // One pin and one release per hop, no temporaries
+    void move_to(Node<value_type>* next) {
+        CLinkedList<ValueType>::inc_ref_count(next);
+        auto old = ptr;
+        ptr = next;
+        CLinkedList<ValueType>::dec_ref_count(old);
+    }
+
+    Node<value_type>* ptr = nullptr;
+    CLinkedList<value_type>* list = nullptr;
+};
+
+// Plain pointer walk over live nodes, see CLinkedList::for_each_borrowed
+template<typename ValueType>
+class BorrowedIterator
+{
+public:
+    using iterator_category = std::forward_iterator_tag;
+    using value_type = ValueType;
+    using difference_type = std::ptrdiff_t;
+    using reference = ValueType&;
+    using pointer = ValueType*;
+
+    BorrowedIterator() noexcept = default;
+    explicit BorrowedIterator(Node<value_type>* _ptr) noexcept : ptr(_ptr) {}
+
+    reference operator*() const noexcept {
+        return ptr->val;
+    }
+
+    pointer operator->() const noexcept {
+        return &(ptr->val);
+    }
+
+    BorrowedIterator& operator++() noexcept {
+        ptr = ptr->next;
+        return *this;
+    }
+
+    BorrowedIterator operator++(int) noexcept {
+        BorrowedIterator old(*this);
+        ptr = ptr->next;
+        return old;
+    }
+
+    friend bool operator==(const BorrowedIterator& a, const BorrowedIterator& b) noexcept {
+        return a.ptr == b.ptr;
+    }
+
+    friend bool operator!=(const BorrowedIterator& a, const BorrowedIterator& b) noexcept {
+        return !(a == b);
+    }
+
+    // Pins the current element for use after the borrow ends
+    ListIterator<value_type> pin(CLinkedList<value_type>& list) const {
+        return ListIterator<value_type>(ptr, &list);
+    }
+
+private:
+    Node<value_type>* ptr = nullptr;
+};
+
+template<typename ValueType>
+class BorrowedRange
+{
+public:
+    using iterator = BorrowedIterator<ValueType>;
+
+    explicit BorrowedRange(CLinkedList<ValueType>& _list) : list(_list) {
+        list.m_borrows++;
+    }
+
+    ~BorrowedRange() {
+        list.m_borrows--;
+    }
+
+    BorrowedRange(const BorrowedRange& other) = delete;
+    BorrowedRange& operator=(const BorrowedRange& other) = delete;
+
+    iterator begin() const noexcept {
+        return iterator(list.head->next);
+    }
+
+    iterator end() const noexcept {
+        return iterator(list.tail);
     }
 
 private:
-    Node<value_type>* ptr;
-    CLinkedList<value_type>* list;
-};
\ No newline at end of file
+    CLinkedList<ValueType>& list;
+};
@@ -0,0 +1,172 @@
+#pragma once
+
+#include <cstddef>
+#include <functional>
+#include <limits>
+#include <stdexcept>
+#include <unordered_map>
+#include <utility>
+
+#include "Iterator.cpp"
+
+// Least recently used cache: a CLinkedList in recency order, most recent
+// first, plus a hash index of iterators into it. A hit moves the entry to
+// the front with CLinkedList::splice, which relinks the node in place, so
+// hits never allocate or free.
+//
+// Evicts from the back once there are more than capacity entries or the
+// entries weigh more than max_weight in total. The weigher defaults to 1
+// per entry; on_evict, when set, sees every evicted entry before it goes.
+template<typename Key, typename Value, typename Hash = std::hash<Key>>
+class CLRUCache
+{
+public:
+    using size_type = std::size_t;
+    using key_type = Key;
+    using mapped_type = Value;
+    using weigher_type = std::function<size_type(const Key&, const Value&)>;
+    using evict_callback = std::function<void(const Key&, Value&)>;
+
+    static constexpr size_type unbounded = std::numeric_limits<size_type>::max();
+
+    explicit CLRUCache(size_type capacity, size_type max_weight = unbounded, weigher_type weigher = nullptr) :
+        m_capacity(capacity), m_max_weight(max_weight), m_weight(0), weigher(std::move(weigher)) {
+        if (capacity == 0) throw (std::invalid_argument("Capacity must be positive"));
+    }
+
+    CLRUCache(const CLRUCache& other) = delete;
+    CLRUCache& operator=(const CLRUCache& other) = delete;
+
+    void on_evict(evict_callback callback) {
+        evicted = std::move(callback);
+    }
+
+    // Marks the entry as most recent. nullptr on a miss, otherwise valid
+    // until the entry is evicted or erased.
+    Value* get(const Key& key) {
+        auto found = index.find(key);
+        if (found == index.end()) return nullptr;
+
+        recency.move_to_front(found->second);
+        return &found->second->value;
+    }
+
+    // Looks without promoting
+    Value* peek(const Key& key) {
+        auto found = index.find(key);
+        return found == index.end() ? nullptr : &found->second->value;
+    }
+
+    // Read-only, so concurrent readers can share it. handle is set on a
+    // hit and can be passed to touch() later to promote the entry then.
+    const Value* peek(const Key& key, WeakHandle& handle) const {
+        auto found = index.find(key);
+        if (found == index.end()) return nullptr;
+
+        handle = recency.handle(found->second);
+        return &found->second->value;
+    }
+
+    void put(const Key& key, Value value) {
+        // Weighed before anything changes, a throwing weigher leaves the cache as it was
+        size_type weight = weigh(key, value);
+
+        auto [found, inserted] = index.try_emplace(key);
+        if (!inserted) {
+            auto& entry = *found->second;
+            entry.value = std::move(value);
+            m_weight = m_weight - entry.weight + weight;
+            entry.weight = weight;
+            recency.move_to_front(found->second);
+        }
+        else {
+            try {
+                recency.push_front(Entry{ key, std::move(value), weight });
+            }
+            catch (...) {
+                index.erase(found);
+                throw;
+            }
+            found->second = recency.begin();
+            m_weight += weight;
+        }
+
+        // Never evicts the entry just put, even if it alone is over the limit
+        while (index.size() > 1 && (index.size() > m_capacity || m_weight > m_max_weight)) evict_last();
+    }
+
+    // Promotes without reading, false on a miss
+    bool touch(const Key& key) {
+        auto found = index.find(key);
+        if (found == index.end()) return false;
+
+        recency.move_to_front(found->second);
+        return true;
+    }
+
+    // Deferred promotion, false once the entry is gone
+    bool touch(const WeakHandle& handle) {
+        auto position = recency.resolve(handle);
+        if (position == recency.end()) return false;
+
+        recency.move_to_front(position);
+        return true;
+    }
+
+    bool erase(const Key& key) {
+        auto found = index.find(key);
+        if (found == index.end()) return false;
+
+        m_weight -= found->second->weight;
+        auto position = found->second;
+        index.erase(found);
+        recency.erase(position);
+        return true;
+    }
+
+    bool contains(const Key& key) const {
+        return index.count(key) != 0;
+    }
+
+    size_type size() const noexcept {
+        return index.size();
+    }
+
+    size_type capacity() const noexcept {
+        return m_capacity;
+    }
+
+    size_type weight() const noexcept {
+        return m_weight;
+    }
+
+private:
+    struct Entry {
+        Key key;
+        Value value;
+        size_type weight;
+    };
+
+    using list_type = CLinkedList<Entry>;
+
+    size_type weigh(const Key& key, const Value& value) const {
+        return weigher ? weigher(key, value) : 1;
+    }
+
+    void evict_last() {
+        auto last = --recency.end();
+        if (evicted) evicted(last->key, last->value);
+
+        m_weight -= last->weight;
+        index.erase(last->key);
+        recency.erase(last);
+    }
+
+    list_type recency;
+    std::unordered_map<Key, typename list_type::iterator, Hash> index;
+    const size_type m_capacity;
+    const size_type m_max_weight;
+    size_type m_weight;
+    weigher_type weigher;
+    evict_callback evicted;
+};
@@ -0,0 +1,213 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <fstream>
+#include <functional>
+#include <ostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+#include "ThreadSlot.hpp"
+
+// Opt-in operation counters and latency histograms for a CLinkedList,
+// attached with CLinkedList::attach_metrics(). Every thread records into
+// its own shard with plain relaxed stores, the exporter sums the shards up
+// and writes Prometheus text format.
+//
+// Histograms are log-linear: four linear buckets per power of two of
+// nanoseconds, so every bucket is at most 25% wide.
+class ListMetrics
+{
+public:
+    enum Op { push, insert, erase, clear, step, kOps };
+    // Only the mutating calls are timed, iteration steps are just counted
+    static constexpr int kTimedOps = step;
+    static constexpr int kBuckets = 160;
+
+    explicit ListMetrics(std::string name) : m_name(escape(std::move(name))) {}
+
+    ListMetrics(const ListMetrics& other) = delete;
+    ListMetrics& operator=(const ListMetrics& other) = delete;
+
+    ~ListMetrics() {
+        for (auto& shard : shards) delete shard.load(std::memory_order_relaxed);
+    }
+
+    void count(Op op) {
+        add(local().counts[op], 1);
+    }
+
+    void record(Op op, std::chrono::nanoseconds elapsed) {
+        Shard& shard = local();
+        auto ns = static_cast<std::uint64_t>(elapsed.count() > 0 ? elapsed.count() : 0);
+        add(shard.counts[op], 1);
+        add(shard.buckets[op][bucket(ns)], 1);
+        add(shard.sum_ns[op], ns);
+    }
+
+    // Times one call when metrics is attached, costs a branch when it isn't
+    class Timer
+    {
+    public:
+        Timer(ListMetrics* _metrics, Op _op) : metrics(_metrics), op(_op) {
+            if (metrics) start = std::chrono::steady_clock::now();
+        }
+
+        ~Timer() {
+            if (metrics) metrics->record(op, std::chrono::steady_clock::now() - start);
+        }
+
+        Timer(const Timer& other) = delete;
+        Timer& operator=(const Timer& other) = delete;
+
+    private:
+        ListMetrics* metrics;
+        Op op;
+        std::chrono::steady_clock::time_point start;
+    };
+
+    std::uint64_t total(Op op) const {
+        std::uint64_t sum = 0;
+        for (auto& shard : shards) {
+            if (auto s = shard.load(std::memory_order_acquire)) sum += s->counts[op].load(std::memory_order_relaxed);
+        }
+        return sum;
+    }
+
+    // All metrics in one exposition, HELP and TYPE once per family
+    static void write_prometheus(std::ostream& out, const std::vector<const ListMetrics*>& all) {
+        out << "# HELP clinkedlist_operations_total Calls and iterator steps on a CLinkedList.\n";
+        out << "# TYPE clinkedlist_operations_total counter\n";
+        for (auto metrics : all) {
+            for (int op = 0; op < kOps; op++) {
+                out << "clinkedlist_operations_total{list=\"" << metrics->m_name << "\",op=\"" << kOpNames[op] << "\"} "
+                    << metrics->total(static_cast<Op>(op)) << '\n';
+            }
+        }
+
+        out << "# HELP clinkedlist_operation_duration_seconds Latency of mutating CLinkedList calls.\n";
+        out << "# TYPE clinkedlist_operation_duration_seconds histogram\n";
+        for (auto metrics : all) {
+            for (int op = 0; op < kTimedOps; op++) metrics->write_histogram(out, static_cast<Op>(op));
+        }
+    }
+
+    void write_prometheus(std::ostream& out) const {
+        write_prometheus(out, { this });
+    }
+
+    // false when the file can't be written
+    bool write_prometheus(const std::string& path) const {
+        std::ofstream file(path, std::ios::trunc);
+        write_prometheus(file);
+        return static_cast<bool>(file.flush());
+    }
+
+    void scrape(const std::function<void(const std::string&)>& callback) const {
+        std::ostringstream text;
+        write_prometheus(text);
+        callback(text.str());
+    }
+
+    // Inclusive upper bound of bucket index in nanoseconds
+    static std::uint64_t bucket_bound(int index) {
+        if (index < 4) return static_cast<std::uint64_t>(index);
+
+        int exponent = index / 4 + 1;
+        std::uint64_t width = std::uint64_t(1) << (exponent - 2);
+        return (4 + static_cast<std::uint64_t>(index % 4)) * width + width - 1;
+    }
+
+    static int bucket(std::uint64_t ns) {
+        if (ns < 4) return static_cast<int>(ns);
+
+        int exponent = floor_log2(ns);
+        int index = (exponent - 1) * 4 + static_cast<int>((ns >> (exponent - 2)) & 3);
+        return index < kBuckets ? index : kBuckets - 1;
+    }
+
+private:
+    static constexpr const char* kOpNames[kOps] = { "push", "insert", "erase", "clear", "step" };
+
+    struct alignas(64) Shard {
+        std::atomic<std::uint64_t> counts[kOps] = {};
+        std::atomic<std::uint64_t> sum_ns[kTimedOps] = {};
+        std::atomic<std::uint64_t> buckets[kTimedOps][kBuckets] = {};
+    };
+
+    // Only the thread holding the slot writes, so no read-modify-write needed
+    static void add(std::atomic<std::uint64_t>& counter, std::uint64_t n) {
+        counter.store(counter.load(std::memory_order_relaxed) + n, std::memory_order_relaxed);
+    }
+
+    static int floor_log2(std::uint64_t v) {
+#if defined(_MSC_VER)
+        unsigned long index;
+        _BitScanReverse64(&index, v);
+        return static_cast<int>(index);
+#else
+        return 63 - __builtin_clzll(v);
+#endif
+    }
+
+    // Exact decimal, a double would round big sums
+    static std::string seconds(std::uint64_t ns) {
+        std::string fraction = std::to_string(ns % 1000000000);
+        return std::to_string(ns / 1000000000) + "." + std::string(9 - fraction.size(), '0') + fraction;
+    }
+
+    static std::string escape(std::string label) {
+        std::string out;
+        for (char c : label) {
+            if (c == '\\' || c == '"') out += '\\';
+            if (c == '\n') out += "\\n";
+            else out += c;
+        }
+        return out;
+    }
+
+    Shard& local() {
+        auto& slot = shards[ThreadSlot::current()];
+        auto shard = slot.load(std::memory_order_acquire);
+        if (shard) return *shard;
+
+        shard = new Shard();
+        slot.store(shard, std::memory_order_release);
+        return *shard;
+    }
+
+    void write_histogram(std::ostream& out, Op op) const {
+        std::uint64_t counts[kBuckets] = {};
+        std::uint64_t sum_ns = 0;
+        for (auto& shard : shards) {
+            auto s = shard.load(std::memory_order_acquire);
+            if (!s) continue;
+
+            sum_ns += s->sum_ns[op].load(std::memory_order_relaxed);
+            for (int i = 0; i < kBuckets; i++) counts[i] += s->buckets[op][i].load(std::memory_order_relaxed);
+        }
+
+        std::string labels = "{list=\"" + m_name + "\",op=\"" + kOpNames[op] + "\"";
+        std::uint64_t cumulative = 0;
+        for (int i = 0; i < kBuckets - 1; i++) {
+            cumulative += counts[i];
+            // Whole nanoseconds, so everything up to bound is also below bound + 1
+            out << "clinkedlist_operation_duration_seconds_bucket" << labels << ",le=\""
+                << seconds(bucket_bound(i) + 1) << "\"} " << cumulative << '\n';
+        }
+        cumulative += counts[kBuckets - 1];
+        out << "clinkedlist_operation_duration_seconds_bucket" << labels << ",le=\"+Inf\"} " << cumulative << '\n';
+        out << "clinkedlist_operation_duration_seconds_sum" << labels << "} " << seconds(sum_ns) << '\n';
+        out << "clinkedlist_operation_duration_seconds_count" << labels << "} " << cumulative << '\n';
+    }
+
+    const std::string m_name;
+    std::atomic<Shard*> shards[kMaxThreads] = {};
+};
@@ -0,0 +1,84 @@
+#pragma once
+
+#include <cstdint>
+#include <stdexcept>
+#include <vector>
+
+template<typename ValueType>
+class Node;
+
+// Weak reference to a list element: slot index plus the generation the
+// slot had when the element was inserted. Doesn't keep anything alive.
+struct WeakHandle
+{
+    std::uint32_t index = ~std::uint32_t(0);
+    std::uint32_t generation = 0;
+
+    friend bool operator==(const WeakHandle& a, const WeakHandle& b) {
+        return a.index == b.index && a.generation == b.generation;
+    }
+
+    friend bool operator!=(const WeakHandle& a, const WeakHandle& b) {
+        return !(a == b);
+    }
+};
+
+// Slot table of the live nodes of one list. Every inserted node gets a
+// slot, erasing it bumps the slot's generation and recycles the slot, so
+// a stale WeakHandle never resolves, even after the slot was reused.
+template<typename ValueType>
+class NodePool
+{
+public:
+    static constexpr std::uint32_t kNoSlot = ~std::uint32_t(0);
+
+    std::uint32_t attach(Node<ValueType>* node) {
+        if (free_slots.empty()) {
+            if (slots.size() >= kNoSlot) throw (std::length_error("Node pool is full"));
+            slots.push_back(Slot{ node, 0 });
+            return static_cast<std::uint32_t>(slots.size() - 1);
+        }
+
+        std::uint32_t index = free_slots.back();
+        free_slots.pop_back();
+        slots[index].node = node;
+        return index;
+    }
+
+    void detach(std::uint32_t index) {
+        slots[index].node = nullptr;
+        slots[index].generation++;
+        free_slots.push_back(index);
+    }
+
+    // The element in slot index now lives in node, its handles stay valid
+    void relocate(std::uint32_t index, Node<ValueType>* node) {
+        slots[index].node = node;
+    }
+
+    // Whether node is the live element in slot index
+    bool holds(std::uint32_t index, const Node<ValueType>* node) const {
+        return index < slots.size() && slots[index].node == node;
+    }
+
+    WeakHandle handle(std::uint32_t index) const {
+        return WeakHandle{ index, slots[index].generation };
+    }
+
+    // nullptr once the element is gone
+    Node<ValueType>* find(const WeakHandle& handle) const {
+        if (handle.index >= slots.size()) return nullptr;
+
+        const Slot& slot = slots[handle.index];
+        return slot.generation == handle.generation ? slot.node : nullptr;
+    }
+
+private:
+    struct Slot {
+        Node<ValueType>* node;
+        std::uint32_t generation;
+    };
+
+    std::vector<Slot> slots;
+    std::vector<std::uint32_t> free_slots;
+};
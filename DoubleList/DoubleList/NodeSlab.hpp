@@ -0,0 +1,73 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <new>
+#include <utility>
+
+// Contiguous storage for list nodes, filled by CLinkedList::relinearize().
+// A slab is one kBytes block aligned to kBytes, so a node finds its slab's
+// header by masking its own address. The header counts the nodes still
+// alive in the slab, plus one while a NodeSlabs is filling it, and whoever
+// takes the count to zero frees the block. Nodes die on whichever thread
+// drops their last reference, so the count is atomic.
+template<typename NodeType>
+class NodeSlabs
+{
+    struct Header {
+        std::atomic<std::size_t> live{ 1 };
+    };
+
+    static constexpr std::size_t kFirst = (sizeof(Header) + alignof(NodeType) - 1) / alignof(NodeType) * alignof(NodeType);
+
+public:
+    static constexpr std::size_t kBytes = std::size_t(1) << 16;
+    // Whether a node fits into a slab at all
+    static constexpr bool usable = kFirst + sizeof(NodeType) <= kBytes;
+
+    NodeSlabs() = default;
+    NodeSlabs(const NodeSlabs& other) = delete;
+    NodeSlabs& operator=(const NodeSlabs& other) = delete;
+
+    ~NodeSlabs() {
+        if (current) release(current);
+    }
+
+    // Constructs the node right behind the one constructed before it
+    template<typename... Args>
+    NodeType* construct(Args&&... args) {
+        if (!current || offset + sizeof(NodeType) > kBytes) {
+            auto fresh = allocate();
+            if (current) release(current);
+            current = fresh;
+            offset = kFirst;
+        }
+
+        auto node = new (reinterpret_cast<char*>(current) + offset) NodeType(std::forward<Args>(args)...);
+        offset += sizeof(NodeType);
+        current->live.fetch_add(1, std::memory_order_relaxed);
+        return node;
+    }
+
+    static void destroy(NodeType* node) {
+        auto header = reinterpret_cast<Header*>(reinterpret_cast<std::uintptr_t>(node) & ~std::uintptr_t(kBytes - 1));
+        node->~NodeType();
+        release(header);
+    }
+
+private:
+    static Header* allocate() {
+        return new (::operator new(kBytes, std::align_val_t(kBytes))) Header();
+    }
+
+    static void release(Header* header) {
+        if (header->live.fetch_sub(1, std::memory_order_acq_rel) != 1) return;
+
+        header->~Header();
+        ::operator delete(header, std::align_val_t(kBytes));
+    }
+
+    Header* current = nullptr;
+    std::size_t offset = 0;
+};
@@ -0,0 +1,188 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <shared_mutex>
+#include <thread>
+#include <vector>
+
+#include "LRUCache.hpp"
+#include "ThreadSlot.hpp"
+
+// CLRUCache split into shards by key hash, each behind its own
+// shared_mutex. Writes lock one shard exclusively; how a hit promotes
+// its entry is up to the Promotion policy:
+//   always   - every hit locks the shard exclusively and promotes, exact LRU
+//   sampled  - hits read under the shared lock, one in kSampleRate promotes
+//   buffered - hits read under the shared lock and drop a weak handle into
+//              the shard's ring; whoever next holds the lock exclusively
+//              replays the ring. The ring is lossy, a promotion may get
+//              overwritten before it is replayed. It is split into
+//              kStripes stripes on lines of their own, one per thread slot
+//              modulo kStripes.
+// Both approximations keep hits off the exclusive lock, so reads scale.
+enum class Promotion { always, sampled, buffered };
+
+template<typename Key, typename Value, typename Hash = std::hash<Key>>
+class CShardedLRUCache
+{
+public:
+    using size_type = std::size_t;
+    using key_type = Key;
+    using mapped_type = Value;
+
+    static constexpr size_type kSampleRate = 8;
+
+    explicit CShardedLRUCache(size_type capacity, Promotion promotion = Promotion::buffered,
+        size_type shard_count = std::thread::hardware_concurrency()) : m_promotion(promotion) {
+        shard_count = std::max<size_type>(std::min(shard_count, capacity), 1);
+        for (size_type i = 0; i < shard_count; i++) {
+            shards.push_back(std::make_unique<Shard>((capacity + shard_count - 1) / shard_count));
+        }
+    }
+
+    CShardedLRUCache(const CShardedLRUCache& other) = delete;
+    CShardedLRUCache& operator=(const CShardedLRUCache& other) = delete;
+
+    std::optional<Value> get(const Key& key) {
+        Shard& shard = shard_for(key);
+
+        if (m_promotion == Promotion::always) {
+            std::unique_lock<std::shared_mutex> lock(shard.lock);
+            auto value = shard.cache.get(key);
+            return value ? std::optional<Value>(*value) : std::nullopt;
+        }
+
+        WeakHandle handle;
+        std::optional<Value> result;
+        {
+            std::shared_lock<std::shared_mutex> lock(shard.lock);
+            auto value = shard.cache.peek(key, handle);
+            if (!value) return std::nullopt;
+            result.emplace(*value);
+        }
+
+        if (m_promotion == Promotion::sampled) {
+            thread_local size_type hits = 0;
+            if (++hits % kSampleRate == 0) {
+                std::unique_lock<std::shared_mutex> lock(shard.lock);
+                shard.cache.touch(handle);
+            }
+        }
+        else {
+            shard.buffer(handle);
+        }
+        return result;
+    }
+
+    void put(const Key& key, Value value) {
+        Shard& shard = shard_for(key);
+        std::unique_lock<std::shared_mutex> lock(shard.lock);
+        shard.drain();
+        shard.cache.put(key, std::move(value));
+    }
+
+    bool erase(const Key& key) {
+        Shard& shard = shard_for(key);
+        std::unique_lock<std::shared_mutex> lock(shard.lock);
+        shard.drain();
+        return shard.cache.erase(key);
+    }
+
+    bool contains(const Key& key) {
+        Shard& shard = shard_for(key);
+        std::shared_lock<std::shared_mutex> lock(shard.lock);
+        return shard.cache.contains(key);
+    }
+
+    size_type size() {
+        size_type total = 0;
+        for (auto& shard : shards) {
+            std::shared_lock<std::shared_mutex> lock(shard->lock);
+            total += shard->cache.size();
+        }
+        return total;
+    }
+
+    size_type shard_count() const noexcept {
+        return shards.size();
+    }
+
+private:
+    // Threads that buffer hits without sharing a cache line, up to the
+    // scale the buffered policy is meant for
+    static constexpr size_type kStripes = 32;
+    // A thread tries to replay the ring after this many buffered hits,
+    // which is also how many it keeps in its stripe
+    static constexpr size_type kDrainEvery = 16;
+    static constexpr std::uint64_t kEmpty = ~std::uint64_t(0);
+
+    struct alignas(64) Stripe {
+        Stripe() {
+            for (auto& slot : slots) slot.store(kEmpty, std::memory_order_relaxed);
+        }
+
+        // Lets drain() skip the stripes nobody wrote to
+        std::atomic<bool> pending{ false };
+        std::atomic<std::uint64_t> slots[kDrainEvery];
+    };
+
+    struct alignas(64) Shard {
+        explicit Shard(size_type capacity) : cache(capacity) {}
+
+        // Threads sharing a stripe are kStripes slots apart, no shared counter
+        void buffer(const WeakHandle& handle) {
+            thread_local size_type writes = 0;
+            Stripe& stripe = stripes[ThreadSlot::current() % kStripes];
+            stripe.slots[writes % kDrainEvery].store(pack(handle), std::memory_order_release);
+            if (!stripe.pending.load(std::memory_order_relaxed)) stripe.pending.store(true, std::memory_order_release);
+
+            if (++writes % kDrainEvery == 0 && lock.try_lock()) {
+                drain();
+                lock.unlock();
+            }
+        }
+
+        // Exclusive lock held. A hit racing the drain of its stripe waits
+        // there for the stripe's next hit to flag it again.
+        void drain() {
+            for (auto& stripe : stripes) {
+                if (!stripe.pending.load(std::memory_order_acquire)) continue;
+
+                stripe.pending.store(false, std::memory_order_relaxed);
+                for (auto& slot : stripe.slots) {
+                    if (slot.load(std::memory_order_relaxed) == kEmpty) continue;
+
+                    auto packed = slot.exchange(kEmpty, std::memory_order_acquire);
+                    if (packed != kEmpty) cache.touch(unpack(packed));
+                }
+            }
+        }
+
+        static std::uint64_t pack(const WeakHandle& handle) {
+            return (std::uint64_t(handle.index) << 32) | handle.generation;
+        }
+
+        static WeakHandle unpack(std::uint64_t packed) {
+            return WeakHandle{ static_cast<std::uint32_t>(packed >> 32), static_cast<std::uint32_t>(packed) };
+        }
+
+        std::shared_mutex lock;
+        CLRUCache<Key, Value, Hash> cache;
+        Stripe stripes[kStripes];
+    };
+
+    // Mixed, so picking a shard and the shard's own map don't use the same hash bits
+    Shard& shard_for(const Key& key) {
+        auto mixed = static_cast<std::uint64_t>(Hash{}(key)) * 0x9E3779B97F4A7C15ull;
+        return *shards[(mixed >> 32) % shards.size()];
+    }
+
+    const Promotion m_promotion;
+    std::vector<std::unique_ptr<Shard>> shards;
+};
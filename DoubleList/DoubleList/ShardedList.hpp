@@ -0,0 +1,190 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <deque>
+#include <cstdint>
+#include <memory>
+#include <queue>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#if defined(_WIN32)
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#elif defined(__linux__)
+#include <sched.h>
+#endif
+
+#include "Iterator.cpp"
+#include "ThreadSlot.hpp"
+
+// Test-and-test-and-set lock for short, normally uncontended sections
+class SpinLock
+{
+public:
+    void lock() {
+        while (m_locked.exchange(true, std::memory_order_acquire)) {
+            while (m_locked.load(std::memory_order_relaxed)) std::this_thread::yield();
+        }
+    }
+
+    void unlock() {
+        m_locked.store(false, std::memory_order_release);
+    }
+
+private:
+    std::atomic<bool> m_locked{ false };
+};
+
+// Append-mostly list split into per-core CLinkedList shards.
+// push_back goes to the shard of the core the caller runs on, so appends
+// from different cores never share a cache line; the shard lock only
+// matters when a thread migrates mid-append.
+//
+// Sequence numbers come from the steady clock instead of a shared counter:
+// nanoseconds since the list was built, shifted left, with the shard index
+// in the low bits. They are unique, grow within a shard and for every
+// writer, and follow real time across shards; ties inside a single tick go
+// by shard index. A shard that gets several appends within one clock tick
+// runs ahead of the clock, so every writer also keeps the last tick it got
+// and never goes below it, even after migrating to a shard that is behind.
+//
+// The tick wraps after 2^56 ns, about 834 days after construction.
+// precedes() compares across the wrap, and the ordered merge uses it, as
+// long as the entries in the list span less than 2^55 ns (417 days).
+// Plain < on sequence numbers is only right before the first wrap.
+template<typename ValueType>
+class CShardedList
+{
+public:
+    using size_type = std::size_t;
+    using value_type = ValueType;
+    using sequence_type = std::uint64_t;
+
+    struct Entry {
+        sequence_type seq;
+        value_type val;
+    };
+
+    static constexpr size_type max_shards = 256;
+
+    explicit CShardedList(size_type shard_count = std::thread::hardware_concurrency()) :
+        m_shards(std::min(std::max<size_type>(shard_count, 1), max_shards)),
+        shards(new Shard[m_shards]),
+        writers(new Writer[kMaxThreads]),
+        m_start(std::chrono::steady_clock::now()) {}
+
+    CShardedList(const CShardedList& other) = delete;
+    CShardedList& operator=(const CShardedList& other) = delete;
+
+    // Whether a was handed out before b, across the wrap
+    static bool precedes(sequence_type a, sequence_type b) noexcept {
+        return static_cast<std::int64_t>(a - b) < 0;
+    }
+
+    sequence_type push_back(value_type value) {
+        auto index = current_cpu() % m_shards;
+        Shard& shard = shards[index];
+
+        auto now = static_cast<sequence_type>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now() - m_start).count());
+
+        // Only this thread touches its slot
+        Writer& writer = writers[ThreadSlot::current()];
+
+        shard.lock.lock();
+        shard.last_tick = std::max({ now, shard.last_tick + 1, writer.last_tick + 1 });
+        writer.last_tick = shard.last_tick;
+        sequence_type seq = (shard.last_tick << kShardBits) | index;
+        shard.list.push_back(Entry{ seq, std::move(value) });
+        shard.lock.unlock();
+
+        return seq;
+    }
+
+    // Shard by shard, ordered only within a shard. f(seq, value)
+    template<typename F>
+    void for_each_unordered(F f) {
+        for (size_type i = 0; i < m_shards; i++) {
+            shards[i].lock.lock();
+            for (auto& entry : shards[i].list.for_each_borrowed()) f(entry.seq, entry.val);
+            shards[i].lock.unlock();
+        }
+    }
+
+    // k-way merge of all shards by sequence number. Holds every shard lock
+    // for the duration, appends wait until it returns. f(seq, value)
+    template<typename F>
+    void for_each_ordered(F f) {
+        using cursor = std::pair<BorrowedIterator<Entry>, BorrowedIterator<Entry>>;
+        auto later = [](const cursor& a, const cursor& b) { return precedes(b.first->seq, a.first->seq); };
+
+        for (size_type i = 0; i < m_shards; i++) shards[i].lock.lock();
+        {
+            // Nothing can be erased under the locks, so the merge needs no ref counting
+            std::deque<BorrowedRange<Entry>> ranges;
+            std::priority_queue<cursor, std::vector<cursor>, decltype(later)> heap(later);
+            for (size_type i = 0; i < m_shards; i++) {
+                auto& range = ranges.emplace_back(shards[i].list);
+                if (range.begin() != range.end()) heap.emplace(range.begin(), range.end());
+            }
+
+            while (!heap.empty()) {
+                cursor top = heap.top();
+                heap.pop();
+                f(top.first->seq, top.first->val);
+                if (++top.first != top.second) heap.push(top);
+            }
+        }
+        for (size_type i = m_shards; i-- > 0;) shards[i].lock.unlock();
+    }
+
+    size_type size() {
+        size_type total = 0;
+        for (size_type i = 0; i < m_shards; i++) {
+            shards[i].lock.lock();
+            total += shards[i].list.size();
+            shards[i].lock.unlock();
+        }
+        return total;
+    }
+
+    size_type shard_count() const noexcept {
+        return m_shards;
+    }
+
+private:
+    static constexpr int kShardBits = 8;
+
+    struct alignas(64) Shard {
+        SpinLock lock;
+        sequence_type last_tick = 0;
+        CLinkedList<Entry> list;
+    };
+
+    // Per thread slot, on a line of its own
+    struct alignas(64) Writer {
+        sequence_type last_tick = 0;
+    };
+
+    static size_type current_cpu() {
+#if defined(_WIN32)
+        return GetCurrentProcessorNumber();
+#elif defined(__linux__)
+        int cpu = sched_getcpu();
+        return cpu >= 0 ? static_cast<size_type>(cpu) : ThreadSlot::current();
+#else
+        return ThreadSlot::current();
+#endif
+    }
+
+    const size_type m_shards;
+    std::unique_ptr<Shard[]> shards;
+    std::unique_ptr<Writer[]> writers;
+    const std::chrono::steady_clock::time_point m_start;
+};
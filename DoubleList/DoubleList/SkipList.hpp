@@ -0,0 +1,447 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <iterator>
+#include <mutex>
+#include <new>
+#include <span>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+#if defined(_MSC_VER)
+#include <xmmintrin.h>
+#endif
+
+#include "EpochReclamation.hpp"
+
+template<typename ValueType, typename Compare>
+class CSkipList;
+
+// Skip list node, values with their tower of links in one allocation.
+// Like Node in CLinkedList it counts its level 0 links and its iterators,
+// and an erased node stays readable, marked deleted, for as long as an
+// iterator holds it. Upper level links aren't counted, only readers inside
+// an epoch follow them.
+template<typename ValueType>
+class alignas(void*) SkipNode
+{
+public:
+    template<typename, typename> friend class CSkipList;
+    template<typename, typename> friend class SkipIterator;
+
+    SkipNode(const SkipNode&) = delete;
+    void operator=(const SkipNode&) = delete;
+
+private:
+    SkipNode(ValueType value, int _level, int refs) : val(std::move(value)), level(_level), deleted(false), ref_count(refs) {
+        for (int i = 0; i < level; i++) new (&next(i)) std::atomic<SkipNode*>(nullptr);
+    }
+
+    static SkipNode* create(ValueType value, int level, int refs) {
+        void* raw = ::operator new(sizeof(SkipNode) + level * sizeof(std::atomic<SkipNode*>));
+        try {
+            return new (raw) SkipNode(std::move(value), level, refs);
+        }
+        catch (...) {
+            ::operator delete(raw);
+            throw;
+        }
+    }
+
+    static void destroy(SkipNode* node) {
+        node->~SkipNode();
+        ::operator delete(node);
+    }
+
+    // The tower sits right behind the node
+    std::atomic<SkipNode*>& next(int i) {
+        return reinterpret_cast<std::atomic<SkipNode*>*>(this + 1)[i];
+    }
+
+    // Fails once the count has hit zero, the node is on its way out then
+    bool try_acquire() {
+        int refs = ref_count.load(std::memory_order_relaxed);
+        while (refs > 0) {
+            if (ref_count.compare_exchange_weak(refs, refs + 1, std::memory_order_acquire, std::memory_order_relaxed)) return true;
+        }
+        return false;
+    }
+
+    ValueType val;
+    const int level;
+    std::atomic<bool> deleted;
+    std::atomic<int> ref_count;
+};
+
+template<typename ValueType, typename Compare = std::less<ValueType>>
+class SkipIterator
+{
+public:
+    using iterator_category = std::forward_iterator_tag;
+    using value_type = ValueType;
+    using difference_type = std::ptrdiff_t;
+    using reference = const ValueType&;
+    using pointer = const ValueType*;
+
+    template<typename, typename> friend class CSkipList;
+
+    SkipIterator() noexcept = default;
+    SkipIterator(const SkipIterator& other) : ptr(other.ptr) {
+        if (ptr) ptr->ref_count.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    ~SkipIterator() {
+        CSkipList<ValueType, Compare>::release(ptr);
+    }
+
+    SkipIterator& operator=(const SkipIterator& other) {
+        if (other.ptr) other.ptr->ref_count.fetch_add(1, std::memory_order_relaxed);
+        CSkipList<ValueType, Compare>::release(ptr);
+        ptr = other.ptr;
+        return *this;
+    }
+
+    // Values are the sort keys, so they are read-only
+    reference operator*() const {
+        if (!ptr || ptr->deleted.load(std::memory_order_acquire)) throw (std::out_of_range("Invalid index"));
+
+        return ptr->val;
+    }
+
+    pointer operator->() const {
+        return &**this;
+    }
+
+    // From an erased node this goes on to the next element still in the list
+    SkipIterator& operator++() {
+        if (!ptr) throw (std::out_of_range("Invalid index"));
+
+        auto next = CSkipList<ValueType, Compare>::first_live(ptr);
+        CSkipList<ValueType, Compare>::release(ptr);
+        ptr = next;
+        return *this;
+    }
+
+    SkipIterator operator++(int) {
+        SkipIterator old(*this);
+        ++*this;
+        return old;
+    }
+
+    friend bool operator==(const SkipIterator& a, const SkipIterator& b) {
+        return a.ptr == b.ptr;
+    }
+
+    friend bool operator!=(const SkipIterator& a, const SkipIterator& b) {
+        return !(a == b);
+    }
+
+    bool is_erased() const {
+        return ptr && ptr->deleted.load(std::memory_order_acquire);
+    }
+
+    int getRefCount() const {
+        return ptr ? ptr->ref_count.load(std::memory_order_relaxed) : 0;
+    }
+
+private:
+    // Adopts a reference the caller already took
+    explicit SkipIterator(SkipNode<ValueType>* node) noexcept : ptr(node) {}
+
+    SkipNode<ValueType>* ptr = nullptr;
+};
+
+// Sorted container with O(log n) insert, find, lower_bound and erase.
+// Equal values are kept, a new one goes after the ones already there.
+//
+// Writers take a mutex; readers (find, lower_bound, contains, begin and
+// iterating) take no lock at all. They walk the towers inside an epoch and
+// only pin the node they hand out, so an unlinked node is retired to the
+// EpochDomain rather than freed while a reader may still be on it.
+//
+// Iterators survive erase the way ListIterator does: the erased node
+// stays readable as deleted, and ++ moves on to the next live element.
+// No iterator may outlive the list.
+template<typename ValueType, typename Compare = std::less<ValueType>>
+class CSkipList
+{
+public:
+    using size_type = std::size_t;
+    using value_type = ValueType;
+    using iterator = SkipIterator<ValueType, Compare>;
+
+    template<typename, typename> friend class SkipIterator;
+
+    static constexpr int kMaxLevel = 16;
+
+    explicit CSkipList(Compare compare = Compare()) : head(node_type::create(value_type(), kMaxLevel, 1)), less(std::move(compare)),
+        m_size(0), m_level(1), m_random(0x9E3779B97F4A7C15ull) {}
+
+    CSkipList(std::initializer_list<value_type> l) : CSkipList() {
+        for (auto& value : l) insert(value);
+    }
+
+    CSkipList(const CSkipList& other) = delete;
+    CSkipList& operator=(const CSkipList& other) = delete;
+
+    // Not thread-safe, every reader and writer has to be finished
+    ~CSkipList() {
+        auto current = head;
+        while (current != nullptr) {
+            auto next = current->next(0).load(std::memory_order_relaxed);
+            node_type::destroy(current);
+            current = next;
+        }
+    }
+
+    iterator insert(value_type value) {
+        std::lock_guard<std::mutex> lock(m_writer);
+
+        node_type* preds[kMaxLevel];
+        auto x = head;
+        for (int level = kMaxLevel - 1; level >= 0; level--) {
+            for (auto n = x->next(level).load(std::memory_order_relaxed); n && !less(value, n->val); n = x->next(level).load(std::memory_order_relaxed)) x = n;
+            preds[level] = x;
+        }
+
+        // One reference for the link from preds[0], one for the iterator
+        int level = random_level();
+        auto node = node_type::create(std::move(value), level, 2);
+        for (int i = 0; i < level; i++) node->next(i).store(preds[i]->next(i).load(std::memory_order_relaxed), std::memory_order_relaxed);
+        // Bottom up, so a reader that sees the node up high finds it below too
+        for (int i = 0; i < level; i++) preds[i]->next(i).store(node, std::memory_order_release);
+
+        m_size.fetch_add(1, std::memory_order_relaxed);
+        return iterator(node);
+    }
+
+    // Returns the next live element
+    iterator erase(const iterator& position) {
+        std::lock_guard<std::mutex> lock(m_writer);
+        auto node = position.ptr;
+        if (!node || node->deleted.load(std::memory_order_relaxed)) throw (std::out_of_range("Invalid index"));
+
+        unlink(node);
+        EpochGuard guard;
+        return iterator(first_live(node));
+    }
+
+    // Erases one element equal to value, false if there is none
+    bool erase(const value_type& value) {
+        std::lock_guard<std::mutex> lock(m_writer);
+        auto x = head;
+        for (int level = kMaxLevel - 1; level >= 0; level--) {
+            for (auto n = x->next(level).load(std::memory_order_relaxed); n && less(n->val, value); n = x->next(level).load(std::memory_order_relaxed)) x = n;
+        }
+        auto node = x->next(0).load(std::memory_order_relaxed);
+        if (!node || less(value, node->val)) return false;
+
+        unlink(node);
+        return true;
+    }
+
+    // First element not less than value, end() if there is none
+    iterator lower_bound(const value_type& value) const {
+        EpochGuard guard;
+        while (true) {
+            auto x = head;
+            for (int level = kMaxLevel - 1; level >= 0; level--) {
+                for (auto n = x->next(level).load(std::memory_order_acquire); n && less(n->val, value); n = x->next(level).load(std::memory_order_acquire)) x = n;
+            }
+
+            node_type* found;
+            if (pin_successor(x, found)) return iterator(found);
+        }
+    }
+
+    iterator find(const value_type& value) const {
+        auto found = lower_bound(value);
+        if (found.ptr && less(value, found.ptr->val)) return iterator();
+        return found;
+    }
+
+    // find() for a batch of keys, results[i] for keys[i]. Up to kInFlight
+    // lookups take turns: each one prefetches the node it has to compare
+    // next and yields to the others, so their cache misses overlap instead
+    // of coming one after another (AMAC).
+    std::vector<iterator> find_many(std::span<const value_type> keys) const {
+        struct Lookup {
+            size_type key;
+            int level;
+            node_type* x;
+            node_type* next;
+        };
+
+        std::vector<iterator> results(keys.size());
+        Lookup lookups[kInFlight];
+        size_type issued = 0, active = 0;
+        auto start = [&](Lookup& lookup, size_type key) {
+            lookup = Lookup{ key, kMaxLevel - 1, head, head->next(kMaxLevel - 1).load(std::memory_order_acquire) };
+        };
+
+        EpochGuard guard;
+        for (; active < kInFlight && issued < keys.size(); active++) start(lookups[active], issued++);
+        while (active > 0) {
+            for (size_type i = 0; i < active;) {
+                Lookup& lookup = lookups[i];
+                const value_type& key = keys[lookup.key];
+                if (lookup.next && less(lookup.next->val, key)) {
+                    lookup.x = lookup.next;
+                }
+                else if (lookup.level > 0) {
+                    lookup.level--;
+                }
+                else {
+                    node_type* found;
+                    if (!pin_successor(lookup.x, found)) {
+                        // Lost a race with erase, this one starts over
+                        start(lookup, lookup.key);
+                        continue;
+                    }
+                    if (found && less(key, found->val)) release(found);
+                    else results[lookup.key] = iterator(found);
+
+                    if (issued < keys.size()) start(lookup, issued++);
+                    else lookup = lookups[--active];
+                    continue;
+                }
+
+                lookup.next = lookup.x->next(lookup.level).load(std::memory_order_acquire);
+                if (lookup.next) prefetch(lookup.next);
+                i++;
+            }
+        }
+        return results;
+    }
+
+    bool contains(const value_type& value) const {
+        EpochGuard guard;
+        auto x = head;
+        for (int level = kMaxLevel - 1; level >= 0; level--) {
+            for (auto n = x->next(level).load(std::memory_order_acquire); n; n = x->next(level).load(std::memory_order_acquire)) {
+                if (less(n->val, value)) x = n;
+                else if (less(value, n->val)) break;
+                else if (!n->deleted.load(std::memory_order_acquire)) return true;
+                else x = n;
+            }
+        }
+        return false;
+    }
+
+    iterator begin() const {
+        EpochGuard guard;
+        return iterator(first_live(head));
+    }
+
+    iterator end() const noexcept {
+        return iterator();
+    }
+
+    bool empty() const {
+        return begin() == end();
+    }
+
+    size_type size() const noexcept {
+        return m_size.load(std::memory_order_relaxed);
+    }
+
+private:
+    using node_type = SkipNode<value_type>;
+
+    // Writer lock held
+    void unlink(node_type* node) {
+        node_type* preds[kMaxLevel];
+        auto x = head;
+        for (int level = kMaxLevel - 1; level >= 0; level--) {
+            for (auto n = x->next(level).load(std::memory_order_relaxed); n && less(n->val, node->val); n = x->next(level).load(std::memory_order_relaxed)) x = n;
+            // Among equal values, walk up to the node itself on the levels it is on
+            if (level < node->level) {
+                for (auto n = x->next(level).load(std::memory_order_relaxed); n != node; n = x->next(level).load(std::memory_order_relaxed)) x = n;
+            }
+            preds[level] = x;
+        }
+
+        node->deleted.store(true, std::memory_order_release);
+        for (int i = node->level - 1; i >= 0; i--) {
+            preds[i]->next(i).store(node->next(i).load(std::memory_order_relaxed), std::memory_order_release);
+        }
+
+        // preds[0] now links the successor, the node still does too
+        if (auto successor = node->next(0).load(std::memory_order_relaxed)) successor->ref_count.fetch_add(1, std::memory_order_relaxed);
+        m_size.fetch_sub(1, std::memory_order_relaxed);
+        release(node);
+    }
+
+    // Lookups find_many keeps going at once
+    static constexpr size_type kInFlight = 16;
+
+    static void prefetch(const void* address) noexcept {
+#if defined(_MSC_VER)
+        _mm_prefetch(static_cast<const char*>(address), _MM_HINT_T0);
+#else
+        __builtin_prefetch(address);
+#endif
+    }
+
+    // Pins the first live node after x into found, nullptr at the end.
+    // false when it lost a race with erase and the lookup has to start over.
+    static bool pin_successor(node_type* x, node_type*& found) {
+        found = x->next(0).load(std::memory_order_acquire);
+        while (found && found->deleted.load(std::memory_order_acquire)) found = found->next(0).load(std::memory_order_acquire);
+        if (!found) return true;
+        if (!found->try_acquire()) return false;
+        if (!found->deleted.load(std::memory_order_acquire)) return true;
+
+        release(found);
+        return false;
+    }
+
+    // The first live node past from, pinned; nullptr at the end. Caller
+    // holds a reference on from or an EpochGuard.
+    static node_type* first_live(node_type* from) {
+        EpochGuard guard;
+        while (true) {
+            auto found = from->next(0).load(std::memory_order_acquire);
+            while (found && found->deleted.load(std::memory_order_acquire)) found = found->next(0).load(std::memory_order_acquire);
+            if (!found) return nullptr;
+            if (!found->try_acquire()) continue;
+            if (!found->deleted.load(std::memory_order_acquire)) return found;
+            release(found);
+        }
+    }
+
+    // A node whose count hits zero drops its level 0 link too, which may
+    // free the successor in turn. Readers in an epoch may still be walking
+    // them, so they go to the EpochDomain instead of straight to delete.
+    static void release(node_type* node) {
+        while (node && node->ref_count.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+            auto next = node->next(0).load(std::memory_order_relaxed);
+            EpochDomain::global().retire(node, [](void* p) { node_type::destroy(static_cast<node_type*>(p)); });
+            node = next;
+        }
+    }
+
+    // Level l with probability 4^-(l-1), never more than one above the tallest
+    int random_level() {
+        m_random ^= m_random << 13;
+        m_random ^= m_random >> 7;
+        m_random ^= m_random << 17;
+
+        int level = 1;
+        for (auto bits = m_random; level < kMaxLevel && (bits & 3) == 0; bits >>= 2) level++;
+        if (level > m_level) level = ++m_level;
+        return level;
+    }
+
+    node_type* const head;
+    Compare less;
+    std::atomic<size_type> m_size;
+    // Writer lock held for these
+    int m_level;
+    std::uint64_t m_random;
+    std::mutex m_writer;
+};
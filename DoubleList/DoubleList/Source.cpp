@@ -1,3 +1,4 @@
+#include <algorithm>
 #include <functional>
 #include <utility>
 #include <type_traits>
@@ -8,8 +9,21 @@
 #include <memory>
 #include <iostream>
 #include <string>
+#include <thread>
+#include <chrono>
+#include <atomic>
+#include <mutex>
 //#include "CLinkedList.hpp"  
 #include "Iterator.cpp"
+#include "ConcurrentList.hpp"
+#include "CombiningList.hpp"
+#include "ShardedList.hpp"
+#include "LRUCache.hpp"
+#include "ShardedLRUCache.hpp"
+#include "TimerWheel.hpp"
+#include "HashIndex.hpp"
+#include "SplitOrderedMap.hpp"
+#include "SkipList.hpp"
 
 #define CATCH_CONFIG_MAIN 
 #include "catch.hpp"
@@ -140,4 +154,1237 @@ TEST_CASE("LinkedList sample", "[CLinkedList]") {
         REQUIRE(!list.empty());
     }
 
+    SECTION("pop front/pop back") {
+        CLinkedList<int> list{ 1,2,3 };
+
+        auto it = list.begin();
+        REQUIRE(list.pop_front() == 1);
+        REQUIRE(list.pop_back() == 3);
+        REQUIRE(list.size() == 1);
+        REQUIRE(*++it == 2);
+
+        REQUIRE(list.pop_back() == 2);
+        REQUIRE_THROWS_AS(list.pop_front(), std::out_of_range);
+    }
+
+    SECTION("iterators on other threads") {
+        CLinkedList<int> list{ 1,2,3 };
+        auto it = ++list.begin();
+        REQUIRE(it.getRefCount() == 3);
+
+        // Copies made and dropped on another thread go through the shared counter.
+        // Catch's assertions aren't thread-safe, the threads only count mismatches.
+        std::vector<std::thread> threads;
+        std::vector<int> mismatches(4, 0);
+        for (int t = 0; t < 4; t++) {
+            threads.emplace_back([&, t] {
+                for (int i = 0; i < 10000; i++) {
+                    auto copy = it;
+                    if (*copy != 2) mismatches[t]++;
+                }
+            });
+        }
+        for (int i = 0; i < 10000; i++) {
+            auto copy = it;
+        }
+        for (auto& t : threads) t.join();
+        REQUIRE(mismatches == std::vector<int>(4, 0));
+        REQUIRE(it.getRefCount() == 3);
+
+        // A reference taken here and dropped there is queued back for merging
+        auto handed = std::make_unique<ListIterator<int>>(it);
+        std::thread([&] { handed.reset(); }).join();
+        REQUIRE(it.getRefCount() == 3);
+
+        list.erase(it);
+        REQUIRE(it.getRefCount() == 1);
+
+        // The last reference goes away on a foreign thread and frees the node
+        auto last = std::make_unique<ListIterator<int>>(it);
+        it = list.begin();
+        std::thread([&] { last.reset(); }).join();
+        REQUIRE(*it == 1);
+        REQUIRE(*++it == 3);
+    }
+
+    SECTION("producer and consumer threads") {
+        // Nodes made by the producer, popped and released by the consumer
+        auto token = std::make_shared<int>(7);
+        CLinkedList<std::shared_ptr<int>> list;
+        std::mutex mutex;
+        const int n = 2000;
+        std::atomic<int> stage{ 0 };
+
+        std::thread producer([&] {
+            for (int i = 0; i < n; i++) {
+                std::lock_guard<std::mutex> lock(mutex);
+                list.push_back(token);
+            }
+            while (stage.load() != 1) std::this_thread::yield();
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                list.push_back(token);
+            }
+            stage = 2;
+            while (stage.load() != 3) std::this_thread::yield();
+        });
+
+        for (int popped = 0; popped < n;) {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (list.empty()) continue;
+            list.erase(list.begin());
+            popped++;
+        }
+        stage = 1;
+        while (stage.load() != 2) std::this_thread::yield();
+
+        // The producer's next push settled everything it was handed, while it is still running
+        REQUIRE(token.use_count() == 2);
+#ifdef CLINKEDLIST_ENABLE_STATS
+        auto stats = list.stats();
+        REQUIRE(stats.live == 1);
+        REQUIRE(stats.zombies == 0);
+        REQUIRE(stats.frees == n);
+#endif
+        stage = 3;
+        producer.join();
+    }
+
+    SECTION("deferred ref counts") {
+        CLinkedList<int> list{ 1,2,3 };
+        auto second = ++list.begin();
+        REQUIRE(second.getRefCount() == 3);
+
+        {
+            DeferredRefCounts<int> scope;
+            REQUIRE(DeferredRefCounts<int>::active());
+
+            // A read-only walk leaves the counts of the nodes it passes alone
+            int sum = 0;
+            for (auto it = list.begin(); it != list.end(); ++it) sum += *it;
+            REQUIRE(sum == 6);
+            REQUIRE(second.getRefCount() == 3);
+
+            // Pins taken in the scope hold across an erase
+            auto third = list.begin();
+            ++third;
+            ++third;
+            list.erase(third);
+            REQUIRE_THROWS_AS(*third, std::out_of_range);
+            REQUIRE(*--third == 2);
+
+            // Nested scopes flush with the outermost one
+            {
+                DeferredRefCounts<int> inner;
+                auto copy = second;
+                REQUIRE(second.getRefCount() == 3);
+            }
+            REQUIRE(DeferredRefCounts<int>::active());
+        }
+        REQUIRE_FALSE(DeferredRefCounts<int>::active());
+        REQUIRE(second.getRefCount() == 3);
+        REQUIRE(list.size() == 2);
+        REQUIRE(*--list.end() == 2);
+    }
+
+    SECTION("borrowed range") {
+        CLinkedList<int> list{ 1,2,3 };
+        auto second = ++list.begin();
+
+        int sum = 0;
+        for (auto& value : list.for_each_borrowed()) {
+            sum += value;
+            value *= 10;
+        }
+        REQUIRE(sum == 6);
+        REQUIRE(*second == 20);
+
+        {
+            auto range = list.for_each_borrowed();
+            auto it = range.begin();
+            REQUIRE(*it++ == 10);
+            REQUIRE(*it == 20);
+
+            // Borrowed iterators don't pin, so nothing may be erased meanwhile
+            REQUIRE_THROWS_AS(list.erase(second), std::logic_error);
+            REQUIRE_THROWS_AS(list.clear(), std::logic_error);
+            // A refused pop leaves the element as it was
+            REQUIRE_THROWS_AS(list.pop_front(), std::logic_error);
+            REQUIRE_THROWS_AS(list.pop_back(), std::logic_error);
+            REQUIRE(list.size() == 3);
+            REQUIRE(*list.begin() == 10);
+            list.push_back(4);
+
+            auto pinned = it.pin(list);
+            REQUIRE(pinned == second);
+            REQUIRE(pinned.getRefCount() == 4);
+        }
+
+        list.erase(second);
+        REQUIRE(list.size() == 3);
+        auto range = list.for_each_borrowed();
+        REQUIRE(std::distance(range.begin(), range.end()) == 3);
+    }
+
+    SECTION("weak handles") {
+        CLinkedList<int> list{ 1,2,3 };
+        auto second = ++list.begin();
+        auto handle = list.handle(second);
+        auto first = list.handle(list.begin());
+
+        // Handles don't pin
+        REQUIRE(second.getRefCount() == 3);
+        REQUIRE(list.contains(handle));
+        REQUIRE(*list.resolve(handle) == 2);
+
+        list.erase(second);
+        REQUIRE(second.is_erased());
+        REQUIRE_FALSE(list.contains(handle));
+        REQUIRE(list.resolve(handle) == list.end());
+        REQUIRE_THROWS_AS(list.handle(second), std::out_of_range);
+
+        // The slot is recycled under a new generation
+        list.push_back(4);
+        auto fourth = list.handle(--list.end());
+        REQUIRE(fourth.index == handle.index);
+        REQUIRE(fourth != handle);
+        REQUIRE_FALSE(list.contains(handle));
+        REQUIRE(*list.resolve(fourth) == 4);
+        REQUIRE(*list.resolve(first) == 1);
+        REQUIRE_FALSE(list.begin().is_erased());
+    }
+
+    SECTION("erased chains") {
+        auto token = std::make_shared<int>(0);
+        CLinkedList<std::shared_ptr<int>> list;
+        for (int i = 0; i < 10; i++) list.push_back(token);
+
+        // Park on the second element and erase it and the seven behind it
+        auto parked = ++list.begin();
+        auto it = parked;
+        for (int i = 0; i < 8; i++) it = list.erase(it);
+        REQUIRE(token.use_count() == 11);
+
+        // The first step over the chain shortcuts it and frees what only the chain kept
+        auto copy = parked;
+        ++copy;
+        REQUIRE(copy == --list.end());
+        REQUIRE(token.use_count() == 4);
+        REQUIRE(++ListIterator<std::shared_ptr<int>>(parked) == copy);
+
+        // Same backwards
+        list.push_front(token);
+        for (int i = 0; i < 6; i++) list.push_back(token);
+        auto last = --list.end();
+        it = last;
+        for (int i = 0; i < 6; i++) it = --list.erase(it);
+        REQUIRE(token.use_count() == 11);
+
+        copy = last;
+        --copy;
+        REQUIRE(copy == it);
+        REQUIRE(token.use_count() == 6);
+    }
+
+    SECTION("stats") {
+        CLinkedList<int> list{ 1,2,3,4 };
+        auto stats = list.stats();
+        REQUIRE(stats.live == 4);
+
+#ifdef CLINKEDLIST_ENABLE_STATS
+        REQUIRE(stats.allocations == 4);
+        REQUIRE(stats.zombies == 0);
+
+        // Erase 2 and 3 while something sits on 2, 3 lives on through 2's link
+        auto parked = ++list.begin();
+        auto it = list.erase(parked);
+        it = list.erase(it);
+
+        stats = list.stats();
+        REQUIRE(stats.live == 2);
+        REQUIRE(stats.zombies == 2);
+        REQUIRE(stats.zombie_bytes == 2 * sizeof(Node<int>));
+        REQUIRE(stats.longest_zombie_chain == 2);
+        REQUIRE(stats.oldest_zombie_age.count() >= 0);
+        REQUIRE(stats.frees == 0);
+
+        parked = list.begin();
+        stats = list.stats();
+        REQUIRE(stats.zombies == 0);
+        REQUIRE(stats.longest_zombie_chain == 0);
+        REQUIRE(stats.frees == 2);
+        REQUIRE(stats.ref_count_ops > 0);
+#endif
+    }
+
+    SECTION("metrics") {
+        ListMetrics metrics("orders");
+        CLinkedList<int> list{ 1,2 };
+        list.attach_metrics(&metrics);
+
+        list.push_back(3);
+        list.push_front(0);
+        auto it = list.inserts(list.end(), 4);
+        list.erase(it);
+        for (it = list.begin(); it != list.end(); ++it) {}
+        list.clear();
+        list.attach_metrics(nullptr);
+        list.push_back(5);
+
+        REQUIRE(metrics.total(ListMetrics::push) == 2);
+        REQUIRE(metrics.total(ListMetrics::insert) == 1);
+        REQUIRE(metrics.total(ListMetrics::erase) == 1);
+        REQUIRE(metrics.total(ListMetrics::clear) == 1);
+        REQUIRE(metrics.total(ListMetrics::step) == 4);
+
+        std::string text;
+        metrics.scrape([&](const std::string& exposition) { text = exposition; });
+        REQUIRE(text.find("# TYPE clinkedlist_operations_total counter") != std::string::npos);
+        REQUIRE(text.find("clinkedlist_operations_total{list=\"orders\",op=\"push\"} 2\n") != std::string::npos);
+        REQUIRE(text.find("clinkedlist_operation_duration_seconds_bucket{list=\"orders\",op=\"erase\",le=\"+Inf\"} 1\n") != std::string::npos);
+        REQUIRE(text.find("clinkedlist_operation_duration_seconds_count{list=\"orders\",op=\"clear\"} 1\n") != std::string::npos);
+        REQUIRE(text.find("op=\"step\",le=") == std::string::npos);
+
+        // Four linear buckets per power of two
+        REQUIRE(ListMetrics::bucket(3) == 3);
+        REQUIRE(ListMetrics::bucket(8) == 8);
+        REQUIRE(ListMetrics::bucket(9) == 8);
+        REQUIRE(ListMetrics::bucket(10) == 9);
+        REQUIRE(ListMetrics::bucket_bound(8) == 9);
+        for (std::uint64_t ns = 1; ns < (1 << 20); ns = ns * 3 / 2 + 1) {
+            REQUIRE(ns <= ListMetrics::bucket_bound(ListMetrics::bucket(ns)));
+            REQUIRE(ns > ListMetrics::bucket_bound(ListMetrics::bucket(ns) - 1));
+        }
+    }
+
+    SECTION("splice") {
+        CLinkedList<int> list{ 1,2,3,4 };
+        auto third = ++++list.begin();
+        auto handle = list.handle(third);
+        REQUIRE(third.getRefCount() == 3);
+
+        list.move_to_front(third);
+        REQUIRE(std::vector<int>(list.begin(), list.end()) == std::vector<int>{ 3,1,2,4 });
+        REQUIRE(third.getRefCount() == 3);
+        REQUIRE(*list.resolve(handle) == 3);
+
+        list.splice(list.end(), third);
+        list.splice(list.begin(), list.begin());
+        list.splice(++list.begin(), list.begin());
+        REQUIRE(std::vector<int>(list.begin(), list.end()) == std::vector<int>{ 1,2,4,3 });
+        REQUIRE(*--third == 4);
+
+        // Across lists the node moves over, handles into the old list go stale
+        CLinkedList<int> other{ 9 };
+        auto nine = other.begin();
+        auto nine_handle = other.handle(nine);
+        list.splice(list.end(), other, nine);
+        REQUIRE(other.empty());
+        REQUIRE(other.size() == 0);
+        REQUIRE(list.size() == 5);
+        REQUIRE(*--list.end() == 9);
+        REQUIRE_FALSE(other.contains(nine_handle));
+        REQUIRE(*list.resolve(list.handle(nine)) == 9);
+
+        list.erase(nine);
+        REQUIRE(nine.is_erased());
+        REQUIRE(std::vector<int>(list.begin(), list.end()) == std::vector<int>{ 1,2,4,3 });
+
+        CLinkedList<int> full(1);
+        full.push_back(0);
+        REQUIRE_THROWS_AS(full.splice(full.end(), list, list.begin()), std::length_error);
+        REQUIRE_THROWS_AS(list.splice(list.begin(), nine), std::out_of_range);
+
+        // Nothing goes next to an erased position, nor comes from the wrong list
+        auto two = ++list.begin();
+        auto four = ++++list.begin();
+        list.erase(two);
+        REQUIRE_THROWS_AS(list.splice(two, four), std::out_of_range);
+        REQUIRE_THROWS_AS(full.splice(two, full, full.begin()), std::out_of_range);
+        REQUIRE_THROWS_AS(list.splice(list.begin(), other, four), std::out_of_range);
+        REQUIRE_THROWS_AS(other.splice(other.end(), list, full.begin()), std::out_of_range);
+        REQUIRE_THROWS_AS(list.splice(full.begin(), four), std::out_of_range);
+        REQUIRE(std::vector<int>(list.begin(), list.end()) == std::vector<int>{ 1,4,3 });
+        REQUIRE(other.size() == 0);
+        REQUIRE(full.size() == 1);
+    }
+
+    SECTION("capacity") {
+        CLinkedList<int> list(2);
+        REQUIRE(list.capacity() == 2);
+
+        REQUIRE(list.try_push_back(1));
+        list.push_front(0);
+        REQUIRE(!list.try_push_back(2));
+        REQUIRE_THROWS_AS(list.push_back(2), std::length_error);
+
+        list.pop_front();
+        REQUIRE(list.try_push_back(2));
+        REQUIRE(list.size() == 2);
+    }
+
+    SECTION("chunks") {
+        CLinkedList<int> list;
+        for (int i = 0; i < 10; i++) list.push_back(i);
+
+        std::vector<std::size_t> sizes;
+        std::vector<int> seen;
+        list.for_each_chunk([&](std::span<const int> chunk) {
+            sizes.push_back(chunk.size());
+            seen.insert(seen.end(), chunk.begin(), chunk.end());
+        }, 4);
+        REQUIRE(sizes == std::vector<std::size_t>{ 4,4,2 });
+        REQUIRE(seen == std::vector<int>(list.begin(), list.end()));
+
+        // Borrowed while the callback runs
+        REQUIRE_THROWS_AS(list.for_each_chunk([&](std::span<const int>) { list.erase(list.begin()); }), std::logic_error);
+        list.erase(list.begin());
+        REQUIRE_THROWS_AS(list.for_each_chunk([](std::span<const int>) {}, 0), std::invalid_argument);
+
+        CLinkedList<int> empty;
+        int calls = 0;
+        empty.for_each_chunk([&](std::span<const int>) { calls++; });
+        REQUIRE(calls == 0);
+    }
+
+    SECTION("prefetched and interleaved scans") {
+        CLinkedList<int> list;
+        for (int i = 0; i < 100; i++) list.push_back(i);
+
+        std::vector<int> seen;
+        list.for_each_prefetched([&](int value) { seen.push_back(value); }, 3);
+        REQUIRE(seen == std::vector<int>(list.begin(), list.end()));
+
+        // The first call walks in order and records waypoints, the second interleaves
+        for (int pass = 0; pass < 2; pass++) {
+            seen.clear();
+            list.for_each_interleaved([&](int& value) { seen.push_back(value); });
+            if (pass == 0) REQUIRE(seen == std::vector<int>(list.begin(), list.end()));
+            else REQUIRE(std::vector<int>(seen.begin(), seen.begin() + 4) == std::vector<int>{ 0,25,50,75 });
+            std::sort(seen.begin(), seen.end());
+            REQUIRE(seen == std::vector<int>(list.begin(), list.end()));
+        }
+
+        // Erasing drops the waypoints, so nothing stale gets walked
+        for (int i = 0; i < 60; i++) list.pop_back();
+        for (int pass = 0; pass < 2; pass++) {
+            int sum = 0;
+            list.for_each_interleaved([&](int value) { sum += value; }, 8);
+            REQUIRE(sum == 39 * 40 / 2);
+        }
+
+        CLinkedList<int> tiny{ 1,2 };
+        for (int pass = 0; pass < 2; pass++) {
+            int sum = 0;
+            tiny.for_each_interleaved([&](int value) { sum += value; }, 4);
+            tiny.for_each_prefetched([&](int value) { sum += value; });
+            REQUIRE(sum == 6);
+        }
+        REQUIRE_THROWS_AS(tiny.for_each_interleaved([](int) {}, 0), std::invalid_argument);
+    }
+
+    SECTION("find many") {
+        CLinkedList<int> list{ 5,3,8,3,1 };
+        std::vector<int> keys{ 3,7,1,3 };
+        auto found = list.find_many(keys);
+        REQUIRE(found.size() == 4);
+        // The first 3, for both keys asking for it
+        REQUIRE(found[0] == ++list.begin());
+        REQUIRE(found[3] == found[0]);
+        REQUIRE(found[1] == list.end());
+        REQUIRE(*found[2] == 1);
+        REQUIRE(list.find_many({}).empty());
+    }
+
+    SECTION("relinearize") {
+        CLinkedList<std::string> list;
+        for (int i = 0; i < 3000; i++) list.push_back(std::to_string(i));
+        CHashIndex<std::string> index(list);
+
+        auto pinned = index.find("1500");
+        auto handle = list.handle(index.find("10"));
+        auto erased = index.find("2000");
+        list.erase(erased);
+
+        // All but the pinned node and the two the erased one still points at
+        REQUIRE(list.relinearize() == 2999 - 3);
+        REQUIRE(*pinned == "1500");
+        REQUIRE(*++pinned == "1501");
+        REQUIRE_THROWS_AS(*erased, std::out_of_range);
+        REQUIRE(*list.resolve(handle) == "10");
+        REQUIRE(*index.find("2999") == "2999");
+        REQUIRE(index.size() == 2999);
+
+        int expected = 0;
+        for (auto& value : list) {
+            if (expected == 2000) expected++;
+            REQUIRE(value == std::to_string(expected++));
+        }
+
+        // Moving slab nodes again frees the old slabs once they empty out
+        erased = list.end();
+        pinned = list.end();
+        REQUIRE(list.relinearize() == 2999);
+        for (int i = 0; i < 1000; i++) list.erase(index.find(std::to_string(i)));
+        list.push_back("x");
+        REQUIRE(list.relinearize() == 2000);
+        REQUIRE(std::distance(list.begin(), list.end()) == 2000);
+
+        auto range = list.for_each_borrowed();
+        REQUIRE_THROWS_AS(list.relinearize(), std::logic_error);
+
+        // A pin from another thread only shows in the shared count
+        CLinkedList<int> shared{ 1,2,3 };
+        CLinkedList<int>::iterator held;
+        std::thread([&] { held = ++shared.begin(); }).join();
+        REQUIRE(shared.relinearize() == 2);
+        REQUIRE(*held == 2);
+        REQUIRE(std::vector<int>(shared.begin(), shared.end()) == std::vector<int>{ 1,2,3 });
+
+        // Dropped on the owner, the two counts add up to just the links again
+        held = shared.end();
+        REQUIRE(shared.relinearize() == 3);
+
+        // Merged nodes live on the shared count alone and can move too
+        auto handed = std::make_unique<CLinkedList<int>::iterator>(++shared.begin());
+        std::thread([&] { handed.reset(); }).join();
+        REQUIRE(shared.relinearize() == 3);
+        REQUIRE(std::vector<int>(shared.begin(), shared.end()) == std::vector<int>{ 1,2,3 });
+
+        // Nodes another thread created only move on that thread
+        CLinkedList<int> mixed;
+        for (int i = 0; i < 50; i++) mixed.push_back(i);
+        std::atomic<int> stage{ 0 };
+        std::size_t moved_there = 0;
+        std::thread producer([&] {
+            for (int i = 50; i < 100; i++) mixed.push_back(i);
+            stage = 1;
+            while (stage.load() != 2) std::this_thread::yield();
+            moved_there = mixed.relinearize();
+        });
+        while (stage.load() != 1) std::this_thread::yield();
+        REQUIRE(mixed.relinearize() == 50);
+        stage = 2;
+        producer.join();
+        REQUIRE(moved_there == 50);
+        std::vector<int> all(100);
+        std::iota(all.begin(), all.end(), 0);
+        REQUIRE(std::vector<int>(mixed.begin(), mixed.end()) == all);
+        // Still the producer's, here they stay put even after it exited
+        REQUIRE(mixed.relinearize() == 50);
+    }
+
+    SECTION("hash index") {
+        CLinkedList<int> list{ 1,2,3 };
+        {
+            // Picks up what is already in the list
+            CHashIndex<int> index(list);
+            REQUIRE(index.size() == 3);
+            REQUIRE(*index.find(2) == 2);
+            REQUIRE(index.find(7) == list.end());
+
+            list.push_back(7);
+            list.inserts(list.begin(), 7);
+            REQUIRE(index.count(7) == 2);
+            list.erase(list.begin());
+            REQUIRE(index.count(7) == 1);
+
+            // Enough churn to rehash, with tombstones left behind
+            for (int i = 100; i < 1100; i++) list.push_back(i);
+            for (int i = 100; i < 1100; i += 2) list.erase(index.find(i));
+            for (int i = 100; i < 1100; i++) REQUIRE(index.contains(i) == (i % 2 == 1));
+            REQUIRE(index.size() == list.size());
+
+            // find() hands out a real iterator
+            auto three = index.find(3);
+            REQUIRE(*++three == 7);
+            list.erase(index.find(3));
+            REQUIRE_FALSE(index.contains(3));
+
+            REQUIRE_THROWS_AS(CHashIndex<int>(list), std::logic_error);
+        }
+        // Detached, the list goes on alone
+        list.push_back(3);
+        REQUIRE(list.size() == 504);
+
+        // Keyed by a member, and following a node spliced across lists
+        struct User { int id; std::string name; };
+        auto by_name = [](const User& user) -> const std::string& { return user.name; };
+        CLinkedList<User> users;
+        CLinkedList<User> others{ User{ 2, "bob" } };
+        CHashIndex<User, decltype(by_name)> names(users, by_name);
+        CHashIndex<User, decltype(by_name)> other_names(others, by_name);
+        users.push_back(User{ 1, "alice" });
+        REQUIRE(names.find("alice")->id == 1);
+
+        users.splice(users.end(), others, others.begin());
+        REQUIRE(names.find("bob")->id == 2);
+        REQUIRE_FALSE(other_names.contains("bob"));
+        users.clear();
+        REQUIRE(names.size() == 0);
+
+        // Popping hands the value out only after the index dropped it
+        CLinkedList<std::string> words{ "one", "two", "three" };
+        CHashIndex<std::string> word_index(words);
+        auto first = words.pop_front();
+        auto last = words.pop_back();
+        REQUIRE(first == "one");
+        REQUIRE(last == "three");
+        REQUIRE_FALSE(word_index.contains(first));
+        REQUIRE_FALSE(word_index.contains(last));
+        REQUIRE(word_index.size() == 1);
+        REQUIRE(*word_index.find("two") == "two");
+    }
+
+}
+
+TEST_CASE("ConcurrentList sample", "[CConcurrentList]") {
+    SECTION("FIFO order") {
+        CConcurrentList<int> list{ 1,2,3 };
+        REQUIRE(list.size() == 3);
+
+        list.push_back(4);
+        for (int i = 1; i <= 4; i++) {
+            REQUIRE(*list.pop_front() == i);
+        }
+        REQUIRE(list.empty());
+        REQUIRE(!list.pop_front());
+    }
+
+    SECTION("pop by move") {
+        CConcurrentList<std::unique_ptr<int>> list;
+        list.push_back(std::make_unique<int>(5));
+
+        auto value = list.pop_front();
+        REQUIRE(**value == 5);
+    }
+
+    SECTION("many producers/consumers") {
+        CConcurrentList<long long> list;
+        const int threads = 4;
+        const long long per_thread = 20000;
+        std::atomic<long long> sum{ 0 };
+        std::atomic<long long> popped{ 0 };
+
+        std::vector<std::thread> workers;
+        for (int t = 0; t < threads; t++) {
+            workers.emplace_back([&, t] {
+                for (long long i = 0; i < per_thread; i++)
+                    list.push_back(t * per_thread + i);
+            });
+            workers.emplace_back([&] {
+                while (popped.load() < threads * per_thread) {
+                    if (auto value = list.pop_front()) {
+                        sum += *value;
+                        popped++;
+                    }
+                }
+            });
+        }
+        for (auto& w : workers) w.join();
+
+        const long long n = threads * per_thread;
+        REQUIRE(sum.load() == n * (n - 1) / 2);
+        REQUIRE(list.empty());
+        REQUIRE(list.size() == 0);
+    }
+
+    SECTION("SPSC") {
+        CConcurrentList<int, SPSC> list;
+        const int n = 50000;
+
+        std::thread producer([&] {
+            for (int i = 0; i < n; i++) list.push_back(i);
+        });
+        for (int expected = 0; expected < n;) {
+            if (auto value = list.pop_front()) {
+                REQUIRE(*value == expected);
+                expected++;
+            }
+        }
+        producer.join();
+        REQUIRE(list.empty());
+        REQUIRE(list.size() == 0);
+    }
+
+    SECTION("MPSC") {
+        CConcurrentList<int, MPSC> list;
+        const int threads = 4;
+        const int per_thread = 20000;
+
+        std::vector<std::thread> producers;
+        for (int t = 0; t < threads; t++) {
+            producers.emplace_back([&, t] {
+                for (int i = 0; i < per_thread; i++) list.push_back(t * per_thread + i);
+            });
+        }
+
+        // Every producer's values must come out in its own push order
+        std::vector<int> last(threads, -1);
+        for (int popped = 0; popped < threads * per_thread;) {
+            if (auto value = list.pop_front()) {
+                int t = *value / per_thread;
+                REQUIRE(*value > last[t]);
+                last[t] = *value;
+                popped++;
+            }
+        }
+        for (auto& p : producers) p.join();
+        REQUIRE(list.empty());
+    }
+
+    SECTION("wait_pop/try_pop_for") {
+        using namespace std::chrono_literals;
+        CConcurrentList<int> list;
+
+        auto start = std::chrono::steady_clock::now();
+        REQUIRE(!list.try_pop_for(20ms));
+        REQUIRE(std::chrono::steady_clock::now() - start >= 20ms);
+
+        std::vector<int> got(4, 0);
+        std::vector<std::thread> consumers;
+        for (int t = 0; t < 4; t++) {
+            consumers.emplace_back([&, t] { got[t] = list.wait_pop(); });
+        }
+        std::this_thread::sleep_for(10ms);
+        for (int i = 1; i <= 4; i++) list.push_back(i);
+        for (auto& c : consumers) c.join();
+
+        std::sort(got.begin(), got.end());
+        REQUIRE(got == std::vector<int>{ 1,2,3,4 });
+
+        std::thread producer([&] {
+            std::this_thread::sleep_for(10ms);
+            list.push_back(7);
+        });
+        REQUIRE(list.try_pop_for(10s) == 7);
+        producer.join();
+    }
+
+    SECTION("bounded") {
+        using namespace std::chrono_literals;
+        CConcurrentList<int> list(2);
+        REQUIRE(list.capacity() == 2);
+
+        REQUIRE(list.try_push_back(1));
+        REQUIRE(list.try_push_back(2));
+        REQUIRE(!list.try_push_back(3));
+        REQUIRE(!list.push_back_for(3, 10ms));
+        REQUIRE(list.size() == 2);
+
+        // The blocked producer gets in as soon as a slot frees up
+        std::thread producer([&] { list.push_back(3); });
+        std::this_thread::sleep_for(10ms);
+        REQUIRE(*list.pop_front() == 1);
+        producer.join();
+        REQUIRE(list.size() == 2);
+        REQUIRE(*list.pop_front() == 2);
+        REQUIRE(*list.pop_front() == 3);
+    }
+
+    SECTION("bounded SPSC/MPSC") {
+        CConcurrentList<int, SPSC> spsc(1);
+        REQUIRE(spsc.try_push_back(1));
+        REQUIRE(!spsc.try_push_back(2));
+        REQUIRE(spsc.size() == 1);
+        REQUIRE(*spsc.pop_front() == 1);
+        REQUIRE(spsc.try_push_back(2));
+
+        const int n = 20000;
+        CConcurrentList<int, MPSC> mpsc(16);
+        std::vector<std::thread> producers;
+        for (int t = 0; t < 4; t++) {
+            producers.emplace_back([&] {
+                for (int i = 0; i < n; i++) mpsc.push_back(i);
+            });
+        }
+        long long sum = 0;
+        for (int i = 0; i < 4 * n; i++) sum += mpsc.wait_pop();
+        for (auto& p : producers) p.join();
+        REQUIRE(sum == 4LL * n * (n - 1) / 2);
+        REQUIRE(mpsc.empty());
+    }
+}
+
+TEST_CASE("CombiningList sample", "[CCombiningList]") {
+    SECTION("push/pop") {
+        CCombiningList<int> list;
+        list.push_back(2);
+        list.push_front(1);
+        list.push_back(3);
+
+        REQUIRE(list.size() == 3);
+        REQUIRE(*list.pop_front() == 1);
+        REQUIRE(*list.pop_back() == 3);
+        REQUIRE(*list.pop_back() == 2);
+        REQUIRE(!list.pop_front());
+    }
+
+    SECTION("apply") {
+        CCombiningList<int> list(2);
+        list.push_back(1);
+        list.push_back(3);
+
+        // Iterators live and die inside the operation
+        int second = list.apply([](CLinkedList<int>& l) {
+            auto it = l.begin();
+            it = l.erase(it);
+            l.inserts(it, 2);
+            return *it;
+        });
+        REQUIRE(second == 3);
+        REQUIRE(*list.pop_front() == 2);
+
+        list.push_back(4);
+        REQUIRE_THROWS_AS(list.push_back(5), std::length_error);
+    }
+
+    SECTION("handles") {
+        CCombiningList<int> list;
+        const int threads = 4;
+        const int per_thread = 2000;
+
+        // Every writer keeps handles to its own elements and erases them later
+        std::vector<std::thread> writers;
+        for (int t = 0; t < threads; t++) {
+            writers.emplace_back([&, t] {
+                std::vector<CCombiningList<int>::iterator> mine;
+                for (int i = 0; i < per_thread; i++) {
+                    mine.push_back(list.inserts(list.apply([](CLinkedList<int>& l) { return l.end(); }), t));
+                }
+                for (auto& handle : mine) list.erase(handle);
+            });
+        }
+        for (auto& w : writers) w.join();
+        REQUIRE(list.size() == 0);
+    }
+
+    SECTION("many writers") {
+        CCombiningList<int> list;
+        const int threads = 8;
+        const int per_thread = 5000;
+
+        std::vector<std::thread> writers;
+        for (int t = 0; t < threads; t++) {
+            writers.emplace_back([&] {
+                for (int i = 0; i < per_thread; i++) {
+                    list.push_back(i);
+                    if (i % 2) list.pop_front();
+                }
+            });
+        }
+        for (auto& w : writers) w.join();
+
+        REQUIRE(list.size() == threads * per_thread / 2);
+    }
+}
+
+TEST_CASE("ShardedList sample", "[CShardedList]") {
+    SECTION("ordered merge") {
+        CShardedList<int> list(4);
+        REQUIRE(list.shard_count() == 4);
+
+        const int threads = 4;
+        const int per_thread = 2000;
+        std::vector<std::thread> writers;
+        for (int t = 0; t < threads; t++) {
+            writers.emplace_back([&, t] {
+                for (int i = 0; i < per_thread; i++) list.push_back(t * per_thread + i);
+            });
+        }
+        for (auto& w : writers) w.join();
+        REQUIRE(list.size() == threads * per_thread);
+
+        // The merge is ordered by sequence and keeps every writer's own order
+        std::vector<int> last(threads, -1);
+        CShardedList<int>::sequence_type previous = 0;
+        int seen = 0;
+        list.for_each_ordered([&](CShardedList<int>::sequence_type seq, int value) {
+            REQUIRE(seq > previous);
+            previous = seq;
+            REQUIRE(value > last[value / per_thread]);
+            last[value / per_thread] = value;
+            seen++;
+        });
+        REQUIRE(seen == threads * per_thread);
+
+        long long sum = 0;
+        list.for_each_unordered([&](CShardedList<int>::sequence_type, int value) { sum += value; });
+        REQUIRE(sum == 1LL * threads * per_thread * (threads * per_thread - 1) / 2);
+    }
+
+    SECTION("sequence grows") {
+        CShardedList<std::string> list(1);
+        auto a = list.push_back("a");
+        auto b = list.push_back("b");
+        REQUIRE(a < b);
+        REQUIRE(CShardedList<std::string>::precedes(a, b));
+
+        // Still in order once the tick wraps
+        using sequence_type = CShardedList<std::string>::sequence_type;
+        sequence_type before_wrap = ~sequence_type(0) << 8;
+        sequence_type after_wrap = sequence_type(1) << 8;
+        REQUIRE(CShardedList<std::string>::precedes(before_wrap, after_wrap));
+        REQUIRE_FALSE(CShardedList<std::string>::precedes(after_wrap, before_wrap));
+    }
+}
+
+TEST_CASE("LRUCache sample", "[CLRUCache]") {
+    SECTION("get/put/touch") {
+        CLRUCache<int, std::string> cache(2);
+        cache.put(1, "one");
+        cache.put(2, "two");
+        REQUIRE(*cache.get(1) == "one");
+
+        // 2 is the least recent now
+        cache.put(3, "three");
+        REQUIRE(cache.size() == 2);
+        REQUIRE_FALSE(cache.contains(2));
+        REQUIRE(cache.get(2) == nullptr);
+
+        REQUIRE(cache.touch(3));
+        REQUIRE_FALSE(cache.touch(2));
+        cache.put(4, "four");
+        REQUIRE(cache.contains(3));
+        REQUIRE_FALSE(cache.contains(1));
+
+        cache.put(3, "THREE");
+        REQUIRE(*cache.peek(3) == "THREE");
+        REQUIRE(cache.erase(3));
+        REQUIRE_FALSE(cache.erase(3));
+        REQUIRE(cache.size() == 1);
+    }
+
+    SECTION("weight and eviction callback") {
+        CLRUCache<std::string, std::string> cache(100, 10, [](const std::string&, const std::string& value) { return value.size(); });
+        std::vector<std::string> evicted;
+        cache.on_evict([&](const std::string& key, std::string&) { evicted.push_back(key); });
+
+        cache.put("a", "aaaa");
+        cache.put("b", "bbbb");
+        REQUIRE(cache.weight() == 8);
+        cache.get("a");
+        cache.put("c", "cccc");
+        REQUIRE(evicted == std::vector<std::string>{ "b" });
+        REQUIRE(cache.weight() == 8);
+
+        // Growing an entry can push others out, the entry itself stays
+        cache.put("a", "aaaaaaaaaaaa");
+        REQUIRE(evicted == std::vector<std::string>{ "b", "c" });
+        REQUIRE(cache.size() == 1);
+        REQUIRE(cache.weight() == 12);
+        REQUIRE_THROWS_AS((CLRUCache<int, int>(0)), std::invalid_argument);
+
+        // A throwing weigher leaves the cache untouched, new key or not
+        CLRUCache<int, std::string> picky(10, 100, [](const int&, const std::string& value) -> std::size_t {
+            if (value == "bad") throw std::invalid_argument("Unweighable");
+            return value.size();
+        });
+        picky.put(1, "one");
+        REQUIRE_THROWS_AS(picky.put(2, "bad"), std::invalid_argument);
+        REQUIRE_THROWS_AS(picky.put(1, "bad"), std::invalid_argument);
+        REQUIRE_FALSE(picky.contains(2));
+        REQUIRE(picky.get(2) == nullptr);
+        REQUIRE(*picky.get(1) == "one");
+        REQUIRE(picky.size() == 1);
+        REQUIRE(picky.weight() == 3);
+        picky.put(2, "two");
+        REQUIRE(picky.weight() == 6);
+    }
+}
+
+TEST_CASE("ShardedLRUCache sample", "[CShardedLRUCache]") {
+    SECTION("exact promotion") {
+        // One shard, so it behaves like CLRUCache
+        CShardedLRUCache<int, int> cache(2, Promotion::always, 1);
+        cache.put(1, 10);
+        cache.put(2, 20);
+        REQUIRE(cache.get(1) == 10);
+        cache.put(3, 30);
+        REQUIRE_FALSE(cache.contains(2));
+        REQUIRE(cache.get(2) == std::nullopt);
+        REQUIRE(cache.erase(1));
+        REQUIRE(cache.size() == 1);
+    }
+
+    SECTION("buffered promotion") {
+        CShardedLRUCache<int, int> cache(2, Promotion::buffered, 1);
+        cache.put(1, 10);
+        cache.put(2, 20);
+
+        // The hit only lands in the ring, the next put replays it before evicting
+        REQUIRE(cache.get(1) == 10);
+        cache.put(3, 30);
+        REQUIRE(cache.contains(1));
+        REQUIRE_FALSE(cache.contains(2));
+    }
+
+    SECTION("many threads") {
+        for (auto promotion : { Promotion::always, Promotion::sampled, Promotion::buffered }) {
+            CShardedLRUCache<int, int> cache(256, promotion, 4);
+            REQUIRE(cache.shard_count() == 4);
+
+            // Checked after join(), Catch's assertions aren't thread-safe
+            std::vector<std::thread> threads;
+            std::vector<int> mismatches(4, 0);
+            for (int t = 0; t < 4; t++) {
+                threads.emplace_back([&, t] {
+                    for (int i = 0; i < 20000; i++) {
+                        int key = (i * 7 + t) % 512;
+                        auto value = cache.get(key);
+                        if (!value) cache.put(key, key * 2);
+                        else if (*value != key * 2) mismatches[t]++;
+                        if (i % 97 == 0) cache.erase(key);
+                    }
+                });
+            }
+            for (auto& t : threads) t.join();
+            REQUIRE(mismatches == std::vector<int>(4, 0));
+            REQUIRE(cache.size() <= 256);
+        }
+    }
+}
+
+TEST_CASE("TimerWheel sample", "[CTimerWheel]") {
+    using namespace std::chrono_literals;
+
+    SECTION("schedule/cancel/reschedule") {
+        CTimerWheel<int> wheel;
+        std::vector<int> fired;
+        auto record = [&](int id) { fired.push_back(id); };
+
+        auto a = wheel.schedule(5ms, 1);
+        auto b = wheel.schedule(3ms, 2);
+        auto c = wheel.schedule(0ms, 3);
+        REQUIRE(wheel.size() == 3);
+
+        REQUIRE(wheel.cancel(b));
+        REQUIRE_FALSE(wheel.cancel(b));
+        REQUIRE(wheel.advance(4ms, record) == 1);
+        REQUIRE(fired == std::vector<int>{ 3 });
+
+        REQUIRE(wheel.reschedule(a, 10ms));
+        REQUIRE(wheel.advance(9ms, record) == 0);
+        REQUIRE(wheel.advance(1ms, record) == 1);
+        REQUIRE(fired == std::vector<int>{ 3, 1 });
+        REQUIRE(wheel.now() == 14);
+
+        // Fired timers can't be cancelled or moved any more
+        REQUIRE_FALSE(wheel.cancel(a));
+        REQUIRE_FALSE(wheel.reschedule(c, 1ms));
+        REQUIRE(wheel.size() == 0);
+    }
+
+    SECTION("cascading") {
+        CTimerWheel<long long> wheel;
+        std::vector<long long> delays = { 1, 999, 1000, 1001, 1999, 59999, 60000, 61234, 3599999, 3600000, 7200001 };
+        std::vector<CTimerWheel<long long>::handle> handles;
+        for (auto delay : delays) handles.push_back(wheel.schedule(std::chrono::milliseconds(delay), delay));
+
+        // Cancelling works from whatever level the timer has cascaded to
+        wheel.advance(1500ms, [](long long) {});
+        REQUIRE(wheel.cancel(handles[6]));
+
+        std::vector<std::pair<long long, unsigned long long>> fired;
+        wheel.advance(std::chrono::milliseconds(7200001 - 1500), [&](long long delay) { fired.emplace_back(delay, wheel.now()); });
+
+        REQUIRE(fired.size() == delays.size() - 5);
+        for (auto& [delay, at] : fired) REQUIRE(static_cast<long long>(at) == delay);
+        REQUIRE(wheel.size() == 0);
+    }
+
+    SECTION("callbacks schedule") {
+        CTimerWheel<int> wheel;
+        int fired = 0;
+        std::function<void(int)> again = [&](int n) {
+            fired++;
+            if (n > 0) wheel.schedule(std::chrono::milliseconds(700), n - 1);
+        };
+        wheel.schedule(700ms, 9);
+        wheel.advance(std::chrono::milliseconds(7000), again);
+        REQUIRE(fired == 10);
+    }
+}
+
+TEST_CASE("SplitOrderedMap sample", "[CSplitOrderedMap]") {
+    SECTION("insert/find/erase") {
+        CSplitOrderedMap<int, std::string> map;
+        REQUIRE(map.insert(1, "one"));
+        REQUIRE(map.insert(2, "two"));
+        REQUIRE_FALSE(map.insert(1, "uno"));
+        REQUIRE(map.find(1) == "one");
+        REQUIRE(map.find(3) == std::nullopt);
+        REQUIRE(map.size() == 2);
+
+        REQUIRE(map.erase(1));
+        REQUIRE_FALSE(map.erase(1));
+        REQUIRE_FALSE(map.contains(1));
+        REQUIRE(map.insert(1, "uno"));
+        REQUIRE(map.find(1) == "uno");
+    }
+
+    SECTION("growing") {
+        CSplitOrderedMap<int, int> map;
+        for (int i = 0; i < 10000; i++) REQUIRE(map.insert(i, i * 2));
+        REQUIRE(map.bucket_count() >= 10000 / CSplitOrderedMap<int, int>::kLoadFactor);
+        for (int i = 0; i < 10000; i += 3) REQUIRE(map.erase(i));
+        for (int i = 0; i < 10000; i++) {
+            if (i % 3 == 0) REQUIRE_FALSE(map.contains(i));
+            else REQUIRE(map.find(i) == i * 2);
+        }
+    }
+
+    SECTION("full hash collisions") {
+        struct Constant { std::size_t operator()(int) const { return 42; } };
+        CSplitOrderedMap<int, int, Constant> map;
+        for (int i = 0; i < 20; i++) map.insert(i, i);
+        REQUIRE(map.erase(7));
+        REQUIRE(map.find(8) == 8);
+        REQUIRE_FALSE(map.contains(7));
+        REQUIRE(map.size() == 19);
+    }
+
+    SECTION("many threads") {
+        CSplitOrderedMap<int, int> map;
+        std::vector<std::thread> threads;
+        // Checked after join(), Catch's assertions aren't thread-safe
+        std::vector<int> failures(4, 0);
+        for (int t = 0; t < 4; t++) {
+            threads.emplace_back([&, t] {
+                // Own keys go in and mostly out again, everyone reads everything
+                for (int i = 0; i < 5000; i++) {
+                    int key = i * 4 + t;
+                    if (!map.insert(key, key)) failures[t]++;
+                    if (i % 2 == 0 && !map.erase(key)) failures[t]++;
+                    auto other = map.find((i * 4 + t + 1) % 20000);
+                    if (other && *other != (i * 4 + t + 1) % 20000) failures[t]++;
+                }
+            });
+        }
+        for (auto& t : threads) t.join();
+        REQUIRE(failures == std::vector<int>(4, 0));
+
+        REQUIRE(map.size() == 10000);
+        for (int key = 0; key < 20000; key++) REQUIRE(map.contains(key) == ((key / 4) % 2 == 1));
+    }
+}
+
+TEST_CASE("SkipList sample", "[CSkipList]") {
+    SECTION("insert/find/lower_bound/erase") {
+        CSkipList<int> list{ 5,1,3 };
+        REQUIRE(std::vector<int>(list.begin(), list.end()) == std::vector<int>{ 1,3,5 });
+        REQUIRE(list.size() == 3);
+
+        REQUIRE(*list.insert(4) == 4);
+        REQUIRE(*list.find(3) == 3);
+        REQUIRE(list.find(2) == list.end());
+        REQUIRE(*list.lower_bound(2) == 3);
+        REQUIRE(list.lower_bound(6) == list.end());
+        REQUIRE(list.contains(4));
+
+        REQUIRE(list.erase(3));
+        REQUIRE_FALSE(list.erase(3));
+        REQUIRE_FALSE(list.contains(3));
+        REQUIRE(*list.erase(list.find(4)) == 5);
+        REQUIRE(std::vector<int>(list.begin(), list.end()) == std::vector<int>{ 1,5 });
+        REQUIRE_THROWS_AS(list.erase(list.end()), std::out_of_range);
+    }
+
+    SECTION("equal values") {
+        CSkipList<std::pair<int, int>, std::function<bool(const std::pair<int, int>&, const std::pair<int, int>&)>> list(
+            [](const std::pair<int, int>& a, const std::pair<int, int>& b) { return a.first < b.first; });
+        for (int i = 0; i < 5; i++) list.insert({ 1, i });
+        list.insert({ 0, 0 });
+
+        // Kept in insertion order, and erasing by iterator takes that very one
+        auto third = list.find({ 1, 0 });
+        ++++third;
+        REQUIRE(third->second == 2);
+        list.erase(third);
+        std::vector<int> seconds;
+        for (auto& value : list) seconds.push_back(value.second);
+        REQUIRE(seconds == std::vector<int>{ 0, 0,1,3,4 });
+    }
+
+    SECTION("find many") {
+        CSkipList<int> list;
+        for (int i = 0; i < 2000; i += 2) list.insert(i);
+
+        // More keys than lookups in flight, hits, misses and repeats
+        std::vector<int> keys;
+        for (int i = -5; i < 2005; i += 3) keys.push_back(i);
+        keys.push_back(10);
+        auto found = list.find_many(keys);
+        REQUIRE(found.size() == keys.size());
+        for (std::size_t i = 0; i < keys.size(); i++) {
+            if (keys[i] >= 0 && keys[i] < 2000 && keys[i] % 2 == 0) REQUIRE(*found[i] == keys[i]);
+            else REQUIRE(found[i] == list.end());
+        }
+        REQUIRE(list.find_many({}).empty());
+    }
+
+    SECTION("iterators survive erase") {
+        CSkipList<int> list;
+        for (int i = 0; i < 100; i++) list.insert(i);
+
+        auto it = list.find(50);
+        auto copy = it;
+        REQUIRE(it.getRefCount() == 3);
+        for (int i = 40; i < 60; i++) list.erase(i);
+
+        REQUIRE(it.is_erased());
+        REQUIRE_THROWS_AS(*it, std::out_of_range);
+        REQUIRE(*++it == 60);
+        REQUIRE(*++copy == 60);
+        REQUIRE(list.size() == 80);
+    }
+
+    SECTION("readers while writing") {
+        CSkipList<int> list;
+        for (int i = 0; i < 1000; i += 2) list.insert(i);
+
+        std::atomic<bool> done{ false };
+        std::vector<std::thread> readers;
+        // Checked after join(), Catch's assertions aren't thread-safe
+        std::vector<int> failures(3, 0);
+        for (int t = 0; t < 3; t++) {
+            readers.emplace_back([&, t] {
+                while (!done.load()) {
+                    // Even values never leave, odd ones come and go
+                    for (int i = 0; i < 1000; i += 2) {
+                        if (!list.contains(i)) failures[t]++;
+                    }
+                    int last = -1;
+                    for (auto it = list.begin(); it != list.end(); ++it) {
+                        // The writer may erase it right under us, then there is nothing to read
+                        int value;
+                        try {
+                            value = *it;
+                        }
+                        catch (const std::out_of_range&) {
+                            continue;
+                        }
+                        if (value <= last) failures[t]++;
+                        last = value;
+                    }
+                    if (list.lower_bound(501) == list.end()) failures[t]++;
+                    std::vector<int> keys{ 0, 2, 500, 998 };
+                    for (auto& it : list.find_many(keys)) {
+                        if (it == list.end()) failures[t]++;
+                    }
+                }
+            });
+        }
+
+        int erased = 0;
+        for (int round = 0; round < 20; round++) {
+            for (int i = 1; i < 1000; i += 2) list.insert(i);
+            for (int i = 1; i < 1000; i += 2) erased += list.erase(i);
+        }
+        done = true;
+        for (auto& t : readers) t.join();
+        REQUIRE(failures == std::vector<int>(3, 0));
+        REQUIRE(erased == 20 * 500);
+        REQUIRE(list.size() == 500);
+    }
 }
@@ -0,0 +1,302 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <optional>
+#include <utility>
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+#include "EpochReclamation.hpp"
+
+// Lock-free hash map (Shalev & Shavit split-ordered list). All entries sit
+// in one sorted lock-free linked list (Harris & Michael): erase first marks
+// the low bit of the node's next pointer, and whoever unlinks the node
+// retires it to the EpochDomain, the same way CConcurrentList's MPMC path
+// reclaims its nodes.
+//
+// The list is sorted by the bit-reversed hash, so the entries of bucket b
+// and of its split bucket b + n stay contiguous when the table doubles
+// from n to 2n buckets. Every bucket is a dummy node in the list that the
+// bucket table points at. Growing only bumps the bucket count, a new bucket
+// gets its dummy the first time anyone touches it, spliced in after its
+// parent's, so nothing is ever rehashed or moved.
+//
+// insert, erase, find and contains are lock-free; a reader pins the epoch
+// for one call and find() hands back a copy of the value.
+template<typename Key, typename Value, typename Hash = std::hash<Key>>
+class CSplitOrderedMap
+{
+public:
+    using size_type = std::size_t;
+    using key_type = Key;
+    using mapped_type = Value;
+
+    // Average entries per bucket before the bucket count doubles
+    static constexpr size_type kLoadFactor = 2;
+
+    CSplitOrderedMap() : m_size(0), m_bucket_count(2) {
+        for (auto& segment : segments) segment.store(nullptr, std::memory_order_relaxed);
+        bucket_slot(0).store(new Link(0), std::memory_order_relaxed);
+    }
+
+    CSplitOrderedMap(const CSplitOrderedMap& other) = delete;
+    CSplitOrderedMap& operator=(const CSplitOrderedMap& other) = delete;
+
+    // Not thread-safe, every other user has to be finished
+    ~CSplitOrderedMap() {
+        auto current = bucket_slot(0).load(std::memory_order_relaxed);
+        while (current != nullptr) {
+            auto next = unmarked(current->next.load(std::memory_order_relaxed));
+            if (current->regular()) delete static_cast<Entry*>(current);
+            else delete current;
+            current = next;
+        }
+        for (auto& segment : segments) delete[] segment.load(std::memory_order_relaxed);
+    }
+
+    // false, with value dropped, when key is already there
+    bool insert(const Key& key, Value value) {
+        EpochGuard guard;
+        auto h = mix(Hash{}(key));
+        auto entry = new Entry(regular_order(h), key, std::move(value));
+        Link* head = bucket(h & (m_bucket_count.load(std::memory_order_acquire) - 1));
+
+        while (true) {
+            Cursor at;
+            if (search(head, entry->order, &key, at)) {
+                delete entry;
+                return false;
+            }
+
+            entry->next.store(at.current, std::memory_order_relaxed);
+            if (at.prev->compare_exchange_weak(at.current, entry, std::memory_order_release, std::memory_order_relaxed)) break;
+        }
+
+        auto size = m_size.fetch_add(1, std::memory_order_relaxed) + 1;
+        auto buckets = m_bucket_count.load(std::memory_order_relaxed);
+        if (size > buckets * kLoadFactor && buckets < kMaxBuckets) {
+            m_bucket_count.compare_exchange_strong(buckets, buckets * 2, std::memory_order_release, std::memory_order_relaxed);
+        }
+        return true;
+    }
+
+    bool erase(const Key& key) {
+        EpochGuard guard;
+        auto h = mix(Hash{}(key));
+        auto order = regular_order(h);
+        Link* head = bucket(h & (m_bucket_count.load(std::memory_order_acquire) - 1));
+
+        while (true) {
+            Cursor at;
+            if (!search(head, order, &key, at)) return false;
+
+            // Marking is the erase, unlinking is only cleanup anyone may finish
+            auto next = at.current->next.load(std::memory_order_acquire);
+            if (is_marked(next)) continue;
+            if (!at.current->next.compare_exchange_weak(next, marked(next), std::memory_order_acq_rel, std::memory_order_relaxed)) continue;
+
+            m_size.fetch_sub(1, std::memory_order_relaxed);
+            auto expected = at.current;
+            if (at.prev->compare_exchange_strong(expected, next, std::memory_order_acq_rel, std::memory_order_relaxed)) {
+                retire(at.current);
+            }
+            else {
+                search(head, order, &key, at);
+            }
+            return true;
+        }
+    }
+
+    std::optional<Value> find(const Key& key) {
+        EpochGuard guard;
+        auto h = mix(Hash{}(key));
+        Cursor at;
+        if (!search(bucket(h & (m_bucket_count.load(std::memory_order_acquire) - 1)), regular_order(h), &key, at)) {
+            return std::nullopt;
+        }
+        return static_cast<Entry*>(at.current)->value;
+    }
+
+    bool contains(const Key& key) {
+        EpochGuard guard;
+        auto h = mix(Hash{}(key));
+        Cursor at;
+        return search(bucket(h & (m_bucket_count.load(std::memory_order_acquire) - 1)), regular_order(h), &key, at);
+    }
+
+    size_type size() const noexcept {
+        return m_size.load(std::memory_order_relaxed);
+    }
+
+    size_type bucket_count() const noexcept {
+        return m_bucket_count.load(std::memory_order_relaxed);
+    }
+
+private:
+    // Segment 0 holds bucket 0, segment s > 0 holds buckets [2^(s-1), 2^s)
+    static constexpr int kSegments = 32;
+    static constexpr size_type kMaxBuckets = size_type(1) << (kSegments - 1);
+
+    // Bucket dummies are Links, entries are Entries. Their orders differ
+    // in the low bit, so a dummy always sorts right before its bucket.
+    struct Link {
+        explicit Link(std::uint64_t _order) : order(_order), next(nullptr) {}
+
+        bool regular() const noexcept {
+            return order & 1;
+        }
+
+        const std::uint64_t order;
+        std::atomic<Link*> next;
+    };
+
+    struct Entry : Link {
+        Entry(std::uint64_t order, const Key& _key, Value _value) : Link(order), key(_key), value(std::move(_value)) {}
+
+        const Key key;
+        Value value;
+    };
+
+    // The link that points at current, and current: the first node not
+    // ordered before the one searched for
+    struct Cursor {
+        std::atomic<Link*>* prev = nullptr;
+        Link* current = nullptr;
+    };
+
+    static bool is_marked(Link* link) noexcept {
+        return reinterpret_cast<std::uintptr_t>(link) & 1;
+    }
+
+    static Link* marked(Link* link) noexcept {
+        return reinterpret_cast<Link*>(reinterpret_cast<std::uintptr_t>(link) | 1);
+    }
+
+    static Link* unmarked(Link* link) noexcept {
+        return reinterpret_cast<Link*>(reinterpret_cast<std::uintptr_t>(link) & ~std::uintptr_t(1));
+    }
+
+    static void retire(Link* link) {
+        EpochDomain::global().retire(static_cast<Entry*>(link));
+    }
+
+    // std::hash is the identity for integers, the bucket index needs its low bits mixed
+    static std::uint64_t mix(std::size_t hash) noexcept {
+        std::uint64_t h = hash;
+        h ^= h >> 33;
+        h *= 0xff51afd7ed558ccdull;
+        h ^= h >> 33;
+        h *= 0xc4ceb9fe1a85ec53ull;
+        h ^= h >> 33;
+        return h;
+    }
+
+    static std::uint64_t reverse(std::uint64_t v) noexcept {
+        v = ((v >> 1) & 0x5555555555555555ull) | ((v & 0x5555555555555555ull) << 1);
+        v = ((v >> 2) & 0x3333333333333333ull) | ((v & 0x3333333333333333ull) << 2);
+        v = ((v >> 4) & 0x0F0F0F0F0F0F0F0Full) | ((v & 0x0F0F0F0F0F0F0F0Full) << 4);
+        v = ((v >> 8) & 0x00FF00FF00FF00FFull) | ((v & 0x00FF00FF00FF00FFull) << 8);
+        v = ((v >> 16) & 0x0000FFFF0000FFFFull) | ((v & 0x0000FFFF0000FFFFull) << 16);
+        return (v >> 32) | (v << 32);
+    }
+
+    static std::uint64_t regular_order(std::uint64_t h) noexcept {
+        return reverse(h) | 1;
+    }
+
+    static std::uint64_t dummy_order(size_type bucket) noexcept {
+        return reverse(bucket);
+    }
+
+    // Walks from head to where order/key belongs, unlinking and retiring
+    // marked nodes on the way. key == nullptr looks for a bucket dummy.
+    // Caller holds an EpochGuard.
+    bool search(Link* head, std::uint64_t order, const Key* key, Cursor& at) {
+    retry:
+        at.prev = &head->next;
+        at.current = at.prev->load(std::memory_order_acquire);
+        while (at.current != nullptr) {
+            auto next = at.current->next.load(std::memory_order_acquire);
+            if (is_marked(next)) {
+                auto expected = at.current;
+                if (!at.prev->compare_exchange_strong(expected, unmarked(next), std::memory_order_acq_rel, std::memory_order_relaxed)) goto retry;
+
+                retire(at.current);
+                at.current = unmarked(next);
+                continue;
+            }
+
+            if (at.current->order > order) return false;
+            if (at.current->order == order) {
+                // Full hash collisions share an order, keep looking past them
+                if (!key || static_cast<Entry*>(at.current)->key == *key) return true;
+            }
+
+            at.prev = &at.current->next;
+            at.current = next;
+        }
+        return false;
+    }
+
+    static int floor_log2(std::uint64_t v) noexcept {
+#if defined(_MSC_VER)
+        unsigned long index;
+        _BitScanReverse64(&index, v);
+        return static_cast<int>(index);
+#else
+        return 63 - __builtin_clzll(v);
+#endif
+    }
+
+    std::atomic<Link*>& bucket_slot(size_type index) {
+        int segment = index == 0 ? 0 : floor_log2(index) + 1;
+        size_type offset = index == 0 ? 0 : index - (size_type(1) << (segment - 1));
+
+        auto table = segments[segment].load(std::memory_order_acquire);
+        if (!table) {
+            size_type length = segment == 0 ? 1 : size_type(1) << (segment - 1);
+            auto fresh = new std::atomic<Link*>[length]();
+            if (segments[segment].compare_exchange_strong(table, fresh, std::memory_order_acq_rel, std::memory_order_acquire)) table = fresh;
+            else delete[] fresh;
+        }
+        return table[offset];
+    }
+
+    // The bucket's dummy, linked in on first use
+    Link* bucket(size_type index) {
+        auto& slot = bucket_slot(index);
+        auto dummy = slot.load(std::memory_order_acquire);
+        if (dummy) return dummy;
+
+        // Parent is index without its top bit, its dummy comes first in the list
+        Link* parent = bucket(index & ~(size_type(1) << floor_log2(index)));
+        auto fresh = new Link(dummy_order(index));
+        while (true) {
+            Cursor at;
+            if (search(parent, fresh->order, nullptr, at)) {
+                delete fresh;
+                dummy = at.current;
+                break;
+            }
+
+            fresh->next.store(at.current, std::memory_order_relaxed);
+            if (at.prev->compare_exchange_weak(at.current, fresh, std::memory_order_release, std::memory_order_relaxed)) {
+                dummy = fresh;
+                break;
+            }
+        }
+
+        Link* expected = nullptr;
+        slot.compare_exchange_strong(expected, dummy, std::memory_order_release, std::memory_order_acquire);
+        return dummy;
+    }
+
+    std::atomic<size_type> m_size;
+    std::atomic<size_type> m_bucket_count;
+    std::atomic<std::atomic<Link*>*> segments[kSegments];
+};
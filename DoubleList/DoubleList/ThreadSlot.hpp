@@ -0,0 +1,103 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <mutex>
+#include <stdexcept>
+#include <vector>
+
+// Upper bound on threads that touch the concurrent containers at the same time
+constexpr std::size_t kMaxThreads = 256;
+
+// Hands every thread a small dense index in [0, kMaxThreads).
+// Slots are recycled when a thread exits, so per-slot state must be
+// left in a state the next owner of the slot can pick up. Work that is
+// still queued for a slot nobody holds can be finished by adopting it.
+class ThreadSlot
+{
+public:
+    using ExitHook = void (*)(std::size_t index);
+
+    static std::size_t current() {
+        std::size_t index = cached();
+        if (index == kNoSlot) [[unlikely]] index = first_use();
+        return index;
+    }
+
+    // Runs after a thread gave its slot back, with the index it held
+    static void on_exit(ExitHook hook) {
+        std::lock_guard<std::mutex> lock(hooks_mutex());
+        hooks().push_back(hook);
+    }
+
+    // Takes a free slot over temporarily, false while some thread holds it
+    static bool try_adopt(std::size_t index) {
+        bool expected = false;
+        return slots()[index].compare_exchange_strong(expected, true, std::memory_order_seq_cst);
+    }
+
+    static void release(std::size_t index) {
+        slots()[index].store(false, std::memory_order_seq_cst);
+    }
+
+private:
+    static constexpr std::size_t kNoSlot = ~std::size_t(0);
+
+    struct Holder {
+        Holder() : index(claim()) {}
+        ~Holder() {
+            release(index);
+
+            std::vector<ExitHook> exit_hooks;
+            {
+                std::lock_guard<std::mutex> lock(hooks_mutex());
+                exit_hooks = hooks();
+            }
+            for (auto hook : exit_hooks) hook(index);
+        }
+
+        std::size_t index;
+    };
+
+    static std::vector<ExitHook>& hooks() {
+        static std::vector<ExitHook> registered;
+        return registered;
+    }
+
+    static std::mutex& hooks_mutex() {
+        static std::mutex mutex;
+        return mutex;
+    }
+
+    // Constant-initialized, so the hot path is a plain TLS load
+    static std::size_t& cached() {
+        thread_local std::size_t index = kNoSlot;
+        return index;
+    }
+
+    // Kept off the hot path, Holder has a destructor so reaching it goes through a TLS init guard
+    static std::size_t first_use() {
+        return cached() = holder().index;
+    }
+
+    static Holder& holder() {
+        thread_local Holder holder;
+        return holder;
+    }
+
+    static std::atomic<bool>* slots() {
+        static std::atomic<bool> used[kMaxThreads] = {};
+        return used;
+    }
+
+    static std::size_t claim() {
+        for (std::size_t i = 0; i < kMaxThreads; i++) {
+            bool expected = false;
+            if (!slots()[i].load(std::memory_order_relaxed) &&
+                slots()[i].compare_exchange_strong(expected, true, std::memory_order_acquire)) {
+                return i;
+            }
+        }
+        throw std::runtime_error("Too many threads");
+    }
+};
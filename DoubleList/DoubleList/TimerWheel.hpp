@@ -0,0 +1,151 @@
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <stdexcept>
+#include <utility>
+
+#include "Iterator.cpp"
+
+// Hierarchical timer wheel: 1000 one-millisecond slots, 60 one-second
+// slots, 60 one-minute slots, and an overflow list for anything further
+// out. Every slot is a CLinkedList of timers.
+//
+// schedule() returns the ListIterator of the timer as its handle. cancel()
+// and reschedule() go straight to the node through it, and cascading a
+// slot down a level splices the nodes over instead of copying them, so
+// a handle stays valid until its timer fires or is cancelled, and all
+// three are O(1).
+//
+// Time only moves in advance(), in whole milliseconds since construction.
+template<typename Payload>
+class CTimerWheel
+{
+public:
+    using size_type = std::size_t;
+    using tick_type = std::uint64_t;
+
+    struct Timer {
+        tick_type deadline = 0;
+        Payload payload = Payload();
+
+        Timer() = default;
+        Timer(tick_type _deadline, Payload _payload) : deadline(_deadline), payload(std::move(_payload)) {}
+
+    private:
+        friend class CTimerWheel;
+        size_type slot = 0;
+    };
+
+    using handle = typename CLinkedList<Timer>::iterator;
+
+    CTimerWheel() : slots(new CLinkedList<Timer>[kSlots]), m_now(0), m_size(0) {}
+
+    CTimerWheel(const CTimerWheel& other) = delete;
+    CTimerWheel& operator=(const CTimerWheel& other) = delete;
+
+    // Fires after at least delay, and at the latest on the advance() that
+    // gets past it. A zero delay means the next millisecond.
+    handle schedule(std::chrono::milliseconds delay, Payload payload) {
+        tick_type deadline = m_now + std::max<tick_type>(static_cast<tick_type>(std::max<long long>(delay.count(), 0)), 1);
+        auto& list = slots[slot_for(deadline)];
+        auto timer = list.inserts(list.end(), Timer(deadline, std::move(payload)));
+        timer->slot = slot_for(deadline);
+        m_size++;
+        return timer;
+    }
+
+    // false when the timer already fired or was cancelled
+    bool cancel(const handle& timer) {
+        if (!timer || timer.is_erased()) return false;
+
+        slots[timer->slot].erase(timer);
+        m_size--;
+        return true;
+    }
+
+    // Moves a pending timer to a new deadline without reallocating it
+    bool reschedule(const handle& timer, std::chrono::milliseconds delay) {
+        if (!timer || timer.is_erased()) return false;
+
+        timer->deadline = m_now + std::max<tick_type>(static_cast<tick_type>(std::max<long long>(delay.count(), 0)), 1);
+        place(timer);
+        return true;
+    }
+
+    // Moves time forward and calls on_expire(payload) for every timer that
+    // came due, in deadline order. on_expire may schedule and cancel.
+    template<typename F>
+    size_type advance(std::chrono::milliseconds elapsed, F&& on_expire) {
+        size_type fired = 0;
+        for (long long i = 0; i < elapsed.count(); i++) {
+            m_now++;
+            if (m_now % kHour == 0) cascade(kOverflow);
+            if (m_now % kMinute == 0) cascade(kMinutes + (m_now / kMinute) % 60);
+            if (m_now % kSecond == 0) cascade(kSeconds + (m_now / kSecond) % 60);
+
+            auto& due = slots[m_now % kSecond];
+            while (!due.empty()) {
+                Payload payload = due.pop_front().payload;
+                m_size--;
+                fired++;
+                on_expire(payload);
+            }
+        }
+        return fired;
+    }
+
+    tick_type now() const noexcept {
+        return m_now;
+    }
+
+    size_type size() const noexcept {
+        return m_size;
+    }
+
+private:
+    static constexpr tick_type kSecond = 1000;
+    static constexpr tick_type kMinute = 60 * kSecond;
+    static constexpr tick_type kHour = 60 * kMinute;
+
+    // Offsets of the levels in slots
+    static constexpr size_type kSeconds = 1000;
+    static constexpr size_type kMinutes = kSeconds + 60;
+    static constexpr size_type kOverflow = kMinutes + 60;
+    static constexpr size_type kSlots = kOverflow + 1;
+
+    size_type slot_for(tick_type deadline) const {
+        tick_type delta = deadline - m_now;
+        if (delta < kSecond) return deadline % kSecond;
+        if (delta < kMinute) return kSeconds + (deadline / kSecond) % 60;
+        if (delta < kHour) return kMinutes + (deadline / kMinute) % 60;
+        return kOverflow;
+    }
+
+    void place(const handle& timer) {
+        auto slot = slot_for(timer->deadline);
+        // Overflow timers still out of range stay put, cascade() walks that list
+        if (slot == timer->slot) return;
+
+        auto& target = slots[slot];
+        target.splice(target.end(), slots[timer->slot], timer);
+        timer->slot = slot;
+    }
+
+    // Everything in the slot is now close enough for a lower level
+    void cascade(size_type slot) {
+        auto& list = slots[slot];
+        for (auto timer = list.begin(); timer != list.end();) {
+            auto next = timer;
+            ++next;
+            place(timer);
+            timer = next;
+        }
+    }
+
+    std::unique_ptr<CLinkedList<Timer>[]> slots;
+    tick_type m_now;
+    size_type m_size;
+};